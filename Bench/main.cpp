@@ -0,0 +1,797 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <iomanip>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cmath>
+
+#include "CPU.h"
+#include "Display.h"
+#include "Batch.h"
+#include "Lockstep.h"
+#include "SnapshotFile.h"
+#include "Rewind.h"
+#include "InputScript.h"
+#include "RunAhead.h"
+#include "FrameSkip.h"
+#include "FramePacer.h"
+#include "Utilities.h"
+
+#define TOP_SEQUENCES 20
+//saves and loads timed per run of the snapshot engine, and frames replayed to check a load
+#define SNAPSHOT_ROUNDS 100000
+#define SNAPSHOT_REPLAY_FRAMES 120
+//the rewind engine's cap, and how many of the newest frames it checks step by step against full snapshots
+#define REWIND_BENCH_BYTES (16 * 1024 * 1024)
+#define REWIND_CHECK_FRAMES 600
+//run-ahead starts from this far into the script, with a game under way, and watches this many frames for a held input to show
+#define RUN_AHEAD_START_FRAME 500
+#define RUN_AHEAD_PROBE_FRAMES 30
+
+#define FAST_FORWARD_MAX 16
+//a present this slow only leaves room for about 25 of the 60 frames each second
+#define ADAPTIVE_PRESENT_MILLISECONDS 40
+#define ADAPTIVE_SECONDS 1.0
+
+#define PACER_BENCH_SECONDS 2.0
+
+#define HANDOFF_RUNS 5
+
+#ifdef CPU_OPCODE_STATS
+//keys hold the opcodes oldest first, one per byte
+void PrintTopSequences(const char* title, std::vector<std::pair<uint32_t, uint64_t>> counts, int length, double instructions) {
+	size_t count = std::min<size_t>(counts.size(), TOP_SEQUENCES);
+	std::partial_sort(counts.begin(), counts.begin() + count, counts.end(),
+		[](const std::pair<uint32_t, uint64_t>& a, const std::pair<uint32_t, uint64_t>& b) { return a.second > b.second; });
+
+	std::cerr << title << ":\n";
+	for (size_t i = 0; i < count; i++) {
+		std::cerr << " ";
+		for (int shift = (length - 1) * 8; shift >= 0; shift -= 8) {
+			std::cerr << " " << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << ((counts[i].first >> shift) & 0xFF);
+		}
+		std::cerr << std::dec << std::setfill(' ') << "  " << counts[i].second << " (" << 100.0 * counts[i].second / instructions << "%)\n";
+	}
+}
+#endif
+
+struct RunResult {
+	double seconds;
+	double cpuSeconds;
+	double displaySeconds;
+	uint64_t cycles;
+	uint64_t instructions;
+};
+
+//every run starts from power-on, so the JIT and block caches are rebuilt each time
+RunResult Run(CPU& cpu, const std::vector<char>& rom, const std::string& engine, size_t frames) {
+	Display display(cpu);
+	cpu.LoadROM(rom.size(), rom.data());
+	if (engine == "jit") cpu.EnableJit(true);
+	if (engine == "recompiled") cpu.EnableRecompiled(true);
+
+	RunResult result = {};
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t i = 0; i < frames; i++) {
+		cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(i));
+		cpu.AddFrame();
+
+		auto cpuStart = std::chrono::steady_clock::now();
+		cpu.Run(FRAME_CYCLES);
+		auto displayStart = std::chrono::steady_clock::now();
+		display.ConvertImage();
+		auto displayEnd = std::chrono::steady_clock::now();
+
+		result.cpuSeconds += std::chrono::duration<double>(displayStart - cpuStart).count();
+		result.displaySeconds += std::chrono::duration<double>(displayEnd - displayStart).count();
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.cycles = cpu.GetCycleCount();
+	result.instructions = cpu.GetInstructionCount();
+	return result;
+}
+
+//Windows paths are full of backslashes
+std::string EscapeJSON(const std::string& text) {
+	std::string result;
+	for (char c : text) {
+		if (c == '\\' || c == '"') result += '\\';
+		result += c;
+	}
+	return result;
+}
+
+//opens every report, 0 frames leaves them out for an engine that runs for a set time instead
+void PrintHeader(const std::string& rom, const std::string& engine, size_t frames) {
+	std::cout << "{\n";
+	std::cout << "  \"rom\": \"" << EscapeJSON(rom) << "\",\n";
+	std::cout << "  \"engine\": \"" << engine << "\",\n";
+	if (frames) std::cout << "  \"frames\": " << frames << ",\n";
+}
+
+//closes one entry of a list with whether its check passed
+void EndRow(bool verified, bool last) {
+	std::cout << ", \"verified\": " << (verified ? "true" : "false") << " }" << (last ? "\n" : ",\n");
+}
+
+//closes a report with whether every check in it passed, which is also what the engine returns
+bool EndReport(bool verified) {
+	std::cout << "  \"verified\": " << (verified ? "true" : "false") << "\n}\n";
+	return verified;
+}
+
+//all instances of a batch play the same script, each starting at a different point in it
+double RunBatch(const std::vector<char>& rom, const std::string& engine, size_t instances, size_t threads, size_t frames) {
+	Batch batch(rom, instances, threads);
+	for (size_t i = 0; i < instances; i++) {
+		if (engine == "jit") batch.GetCPU(i).EnableJit(true);
+		if (engine == "recompiled") batch.GetCPU(i).EnableRecompiled(true);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (size_t frame = 0; frame < frames; frame++) {
+		for (size_t i = 0; i < instances; i++) {
+			batch.GetCPU(i).SetInput(INPUT_PORT_PLAYER, ScriptedInput(frame + i * SCRIPT_FRAMES / instances));
+		}
+		batch.Step(1, true);
+	}
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//thread counts double up to the hardware thread count, the median of the runs is reported for each
+void PrintScaling(const std::vector<char>& rom, const std::string& engine, size_t instances, size_t maxThreads, size_t frames, size_t runs, size_t warmups) {
+	std::cout << "  \"instances\": " << instances << ",\n";
+	std::cout << "  \"hardwareThreads\": " << std::thread::hardware_concurrency() << ",\n";
+	std::cout << "  \"scaling\": [\n";
+
+	std::vector<size_t> threadCounts;
+	for (size_t threads = 1; threads < maxThreads; threads *= 2) {
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	double baseline = 0.0;
+	for (size_t threads : threadCounts) {
+		std::vector<double> times;
+		for (size_t i = 0; i < warmups + runs; i++) {
+			double seconds = RunBatch(rom, engine, instances, threads, frames);
+			if (i >= warmups) times.push_back(seconds);
+		}
+		std::sort(times.begin(), times.end());
+		double seconds = times[times.size() / 2];
+		if (threads == 1) baseline = seconds;
+
+		std::cout << "    { \"threads\": " << threads
+			<< ", \"seconds\": " << seconds
+			<< ", \"framesPerSecond\": " << instances * frames / seconds
+			<< ", \"speedup\": " << baseline / seconds
+			<< ", \"efficiency\": " << baseline / seconds / threads << " }"
+			<< (threads < maxThreads ? ",\n" : "\n");
+	}
+
+	std::cout << "  ]\n}\n";
+}
+
+struct LockstepResult {
+	double lockstepSeconds;
+	double scalarSeconds;
+	double lanesPerStep;
+	bool verified;
+};
+
+//the scalar CPU is the reference, every lane is compared with its own CPU after every frame
+bool MatchesLane(Lockstep& lockstep, size_t lane, CPU& cpu, std::vector<uint8_t>& ram) {
+	State lanes = lockstep.GetState(lane);
+	const State& state = cpu.GetState();
+	lockstep.GetRAM(lane, ram.data());
+
+	return lanes.bc.word == state.bc.word && lanes.de.word == state.de.word && lanes.hl.word == state.hl.word &&
+		lanes.psw.word == state.psw.word && lanes.sp == state.sp && lanes.pc == state.pc &&
+		lanes.interruptEnable == state.interruptEnable && lockstep.GetCycleCount(lane) == cpu.GetCycleCount() &&
+		memcmp(ram.data(), cpu.GetRAM(ROM_SIZE), RAM_SIZE) == 0;
+}
+
+//stagger spreads the lanes over the input script, 0 gives every lane the same input
+LockstepResult RunLockstep(const std::vector<char>& rom, size_t frames, size_t stagger) {
+	std::unique_ptr<Lockstep> lockstep(new Lockstep());
+	lockstep->LoadROM(rom.size(), rom.data());
+	std::vector<std::unique_ptr<CPU>> cpus;
+	for (size_t i = 0; i < LOCKSTEP_LANES; i++) {
+		cpus.emplace_back(new CPU());
+		cpus.back()->LoadROM(rom.size(), rom.data());
+	}
+
+	LockstepResult result = {};
+	result.verified = true;
+	std::vector<uint8_t> ram(RAM_SIZE);
+
+	for (size_t frame = 0; frame < frames && result.verified; frame++) {
+		for (size_t i = 0; i < LOCKSTEP_LANES; i++) {
+			uint8_t input = ScriptedInput(frame + i * stagger);
+			lockstep->SetInput(i, INPUT_PORT_PLAYER, input);
+			cpus[i]->SetInput(INPUT_PORT_PLAYER, input);
+		}
+
+		auto lockstepStart = std::chrono::steady_clock::now();
+		lockstep->RunFrame();
+		auto scalarStart = std::chrono::steady_clock::now();
+		for (auto& cpu : cpus) {
+			cpu->AddFrame();
+			cpu->Run(FRAME_CYCLES);
+		}
+		auto scalarEnd = std::chrono::steady_clock::now();
+
+		result.lockstepSeconds += std::chrono::duration<double>(scalarStart - lockstepStart).count();
+		result.scalarSeconds += std::chrono::duration<double>(scalarEnd - scalarStart).count();
+
+		for (size_t i = 0; i < LOCKSTEP_LANES; i++) {
+			if (!MatchesLane(*lockstep, i, *cpus[i], ram)) {
+				std::cerr << "lane " << i << " differs from its CPU after frame " << frame << "\n";
+				result.verified = false;
+				break;
+			}
+		}
+	}
+
+	result.lanesPerStep = static_cast<double>(lockstep->GetInstructionCount()) / lockstep->GetStepCount();
+	return result;
+}
+
+//lanes that see the same input stay together, staggered input shows the cost of divergence
+bool PrintLockstep(const std::vector<char>& rom, size_t frames, size_t) {
+	std::cout << "  \"lanes\": " << LOCKSTEP_LANES << ",\n";
+	std::cout << "  \"scenarios\": [\n";
+
+	bool verified = true;
+	const char* names[] = { "same", "staggered" };
+	size_t staggers[] = { 0, SCRIPT_FRAMES / LOCKSTEP_LANES };
+	for (size_t i = 0; i < 2; i++) {
+		LockstepResult result = RunLockstep(rom, frames, staggers[i]);
+		verified = verified && result.verified;
+
+		std::cout << "    { \"input\": \"" << names[i] << "\""
+			<< ", \"lockstepSeconds\": " << result.lockstepSeconds
+			<< ", \"scalarSeconds\": " << result.scalarSeconds
+			<< ", \"speedup\": " << result.scalarSeconds / result.lockstepSeconds
+			<< ", \"lanesPerStep\": " << result.lanesPerStep;
+		EndRow(result.verified, i + 1 == 2);
+	}
+
+	std::cout << "  ],\n";
+	return EndReport(verified);
+}
+
+void RunScript(CPU& cpu, size_t first, size_t frames) {
+	for (size_t i = first; i < first + frames; i++) {
+		cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(i));
+		cpu.AddFrame();
+		cpu.Run(FRAME_CYCLES);
+	}
+}
+
+//snapshots are taken mid game, then loaded and replayed to check the machine picks up exactly where it was
+bool PrintSnapshot(const std::vector<char>& rom, size_t frames, size_t runs) {
+	CPU cpu;
+	Display display(cpu);
+	cpu.LoadROM(rom.size(), rom.data());
+	RunScript(cpu, 0, frames);
+
+	Snapshot saved = {};
+	Snapshot scratch = {};
+	cpu.SaveState(saved);
+
+	std::vector<double> saveTimes;
+	std::vector<double> loadTimes;
+	for (size_t run = 0; run < runs; run++) {
+		auto saveStart = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < SNAPSHOT_ROUNDS; i++) {
+			cpu.SaveState(scratch);
+		}
+		auto loadStart = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < SNAPSHOT_ROUNDS; i++) {
+			cpu.LoadState(saved);
+		}
+		auto loadEnd = std::chrono::steady_clock::now();
+
+		saveTimes.push_back(std::chrono::duration<double, std::nano>(loadStart - saveStart).count() / SNAPSHOT_ROUNDS);
+		loadTimes.push_back(std::chrono::duration<double, std::nano>(loadEnd - loadStart).count() / SNAPSHOT_ROUNDS);
+	}
+	std::sort(saveTimes.begin(), saveTimes.end());
+	std::sort(loadTimes.begin(), loadTimes.end());
+
+	std::vector<uint8_t> raw;
+	std::vector<uint8_t> compressed;
+	EncodeSnapshot(saved, false, raw);
+	auto encodeStart = std::chrono::steady_clock::now();
+	EncodeSnapshot(saved, true, compressed);
+	auto decodeStart = std::chrono::steady_clock::now();
+	bool decoded = DecodeSnapshot(compressed.data(), compressed.size(), scratch);
+	auto decodeEnd = std::chrono::steady_clock::now();
+	decoded = decoded && memcmp(&scratch, &saved, sizeof(Snapshot)) == 0;
+
+	//the same frames played on from the snapshot have to end in the same place
+	RunScript(cpu, frames, SNAPSHOT_REPLAY_FRAMES);
+	std::vector<uint8_t> expected(static_cast<uint8_t*>(cpu.GetRAM(ROM_SIZE)), static_cast<uint8_t*>(cpu.GetRAM(ROM_SIZE)) + RAM_SIZE);
+	uint64_t expectedCycles = cpu.GetCycleCount();
+	cpu.LoadState(scratch);
+	RunScript(cpu, frames, SNAPSHOT_REPLAY_FRAMES);
+	bool replayed = cpu.GetCycleCount() == expectedCycles && memcmp(expected.data(), cpu.GetRAM(ROM_SIZE), RAM_SIZE) == 0;
+
+	std::cout << "  \"snapshotBytes\": " << sizeof(Snapshot) << ",\n";
+	std::cout << "  \"saveNanoseconds\": " << saveTimes[saveTimes.size() / 2] << ",\n";
+	std::cout << "  \"loadNanoseconds\": " << loadTimes[loadTimes.size() / 2] << ",\n";
+	std::cout << "  \"fileBytes\": " << raw.size() << ",\n";
+	std::cout << "  \"compressedBytes\": " << compressed.size() << ",\n";
+	std::cout << "  \"compressMicroseconds\": " << std::chrono::duration<double, std::micro>(decodeStart - encodeStart).count() << ",\n";
+	std::cout << "  \"decompressMicroseconds\": " << std::chrono::duration<double, std::micro>(decodeEnd - decodeStart).count() << ",\n";
+	return EndReport(decoded && replayed);
+}
+
+bool MatchesSnapshot(const CPU& cpu, const Snapshot& expected) {
+	Snapshot snapshot = {};
+	cpu.SaveState(snapshot);
+	return memcmp(&snapshot, &expected, sizeof(Snapshot)) == 0;
+}
+
+//every frame is pushed, then the newest are stepped back through one at a time and the oldest is sought to directly
+bool PrintRewind(const std::vector<char>& rom, size_t frames, size_t) {
+	CPU cpu;
+	Display display(cpu);
+	cpu.LoadROM(rom.size(), rom.data());
+	std::unique_ptr<Rewind> rewind(new Rewind(REWIND_BENCH_BYTES));
+	std::vector<Snapshot> recent(REWIND_CHECK_FRAMES);
+	std::vector<size_t> recentBytes(REWIND_CHECK_FRAMES);
+
+	double pushSeconds = 0;
+	for (size_t i = 0; i < frames; i++) {
+		RunScript(cpu, i, 1);
+
+		auto pushStart = std::chrono::steady_clock::now();
+		rewind->Push(cpu);
+		pushSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - pushStart).count();
+
+		cpu.SaveState(recent[i % REWIND_CHECK_FRAMES]);
+		recentBytes[i % REWIND_CHECK_FRAMES] = rewind->GetNewestBytes();
+	}
+
+	size_t held = rewind->GetFrameCount();
+	size_t used = rewind->GetUsedBytes();
+	bool verified = true;
+
+	size_t steps = std::min<size_t>({ REWIND_CHECK_FRAMES - 1, held - 1, frames - 1 });
+	auto stepStart = std::chrono::steady_clock::now();
+	for (size_t i = 1; i <= steps && verified; i++) {
+		verified = rewind->StepBack(cpu) && MatchesSnapshot(cpu, recent[(frames - 1 - i) % REWIND_CHECK_FRAMES]);
+	}
+	double stepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - stepStart).count();
+
+	//pushing the next frame again has to cost what it did the first time, a keyframe only where there was one before
+	if (steps && verified) {
+		size_t next = frames - steps;
+		RunScript(cpu, next, 1);
+		rewind->Push(cpu);
+		verified = rewind->GetNewestBytes() == recentBytes[next % REWIND_CHECK_FRAMES] && rewind->StepBack(cpu);
+	}
+
+	//the oldest frame held is checked against a fresh run to the same point
+	size_t oldest = frames - held;
+	auto seekStart = std::chrono::steady_clock::now();
+	verified = verified && rewind->Seek(cpu, rewind->GetFrameCount() - 1);
+	double seekSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - seekStart).count();
+
+	CPU reference;
+	reference.LoadROM(rom.size(), rom.data());
+	RunScript(reference, 0, oldest + 1);
+	Snapshot expected = {};
+	reference.SaveState(expected);
+	verified = verified && MatchesSnapshot(cpu, expected);
+
+	std::cout << "  \"capacityBytes\": " << rewind->GetCapacity() << ",\n";
+	std::cout << "  \"framesHeld\": " << held << ",\n";
+	std::cout << "  \"secondsHeld\": " << static_cast<double>(held) * FRAME_CYCLES / CLOCK_RATE << ",\n";
+	std::cout << "  \"bytesPerFrame\": " << static_cast<double>(used) / held << ",\n";
+	std::cout << "  \"pushMicroseconds\": " << pushSeconds * 1000000.0 / frames << ",\n";
+	std::cout << "  \"stepBackMicroseconds\": " << (steps ? stepSeconds * 1000000.0 / steps : 0.0) << ",\n";
+	std::cout << "  \"seekOldestMicroseconds\": " << seekSeconds * 1000000.0 << ",\n";
+	return EndReport(verified);
+}
+
+uint64_t HashImage(const Display& display) {
+	const std::vector<Color4>& image = display.GetImage();
+	return HashBytes(image.data(), image.size() * sizeof(Color4));
+}
+
+//the image shown each host frame while holding input from the start snapshot on, ahead of -1 is the queued order the
+//window used to have, converting and presenting before the frame with the new input runs
+std::vector<uint64_t> RunAheadImages(const std::vector<char>& rom, const Snapshot& start, int ahead, uint8_t input, size_t frames, double& seconds) {
+	CPU cpu;
+	Display display(cpu);
+	cpu.LoadROM(rom.size(), rom.data());
+	cpu.LoadState(start);
+	RunAhead runAhead(cpu, display, ahead < 0 ? 0 : ahead);
+
+	std::vector<uint64_t> images;
+	seconds = 0;
+	for (size_t i = 0; i < frames; i++) {
+		cpu.SetInput(INPUT_PORT_PLAYER, input);
+
+		auto begin = std::chrono::steady_clock::now();
+		if (ahead < 0) {
+			display.ConvertImage();
+			images.push_back(HashImage(display));
+			begin = std::chrono::steady_clock::now();
+			cpu.RunFrame();
+		} else {
+			runAhead.RunFrame();
+		}
+		seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		if (ahead >= 0) images.push_back(HashImage(display));
+	}
+	return images;
+}
+
+//lag is how many host frames after the cannon is first pushed right the image shown first differs from leaving it still
+//the game moves the cannon in the frame that reads the input, so lag is all in the order of running and presenting
+//running ahead then shows the game further on than the input, which hides that many frames of swapchain and display latency
+bool PrintRunAhead(const std::vector<char>& rom, size_t frames, size_t) {
+	CPU cpu;
+	cpu.LoadROM(rom.size(), rom.data());
+	RunScript(cpu, 0, RUN_AHEAD_START_FRAME);
+	Snapshot start = {};
+	cpu.SaveState(start);
+
+	size_t probeFrames = RUN_AHEAD_PROBE_FRAMES + MAX_RUN_AHEAD_FRAMES;
+	double seconds;
+	std::vector<uint64_t> still = RunAheadImages(rom, start, 0, INPUT_ALWAYS_ON, probeFrames, seconds);
+	std::vector<uint64_t> moved = RunAheadImages(rom, start, 0, INPUT_ALWAYS_ON | INPUT_P1_RIGHT, probeFrames, seconds);
+
+	std::cout << "  \"startFrame\": " << RUN_AHEAD_START_FRAME << ",\n";
+	std::cout << "  \"modes\": [\n";
+
+	bool verified = true;
+	for (int ahead = -1; ahead <= MAX_RUN_AHEAD_FRAMES; ahead++) {
+		std::vector<uint64_t> aheadStill = RunAheadImages(rom, start, ahead, INPUT_ALWAYS_ON, RUN_AHEAD_PROBE_FRAMES, seconds);
+		std::vector<uint64_t> aheadMoved = RunAheadImages(rom, start, ahead, INPUT_ALWAYS_ON | INPUT_P1_RIGHT, RUN_AHEAD_PROBE_FRAMES, seconds);
+
+		int lag = RUN_AHEAD_PROBE_FRAMES;
+		bool matches = true;
+		for (size_t i = 0; i < RUN_AHEAD_PROBE_FRAMES; i++) {
+			if (lag == RUN_AHEAD_PROBE_FRAMES && aheadStill[i] != aheadMoved[i]) lag = static_cast<int>(i);
+			//the queued order shows the frame before, every run-ahead shows ahead frames after the real one
+			if (ahead >= 0) {
+				matches = matches && aheadStill[i] == still[i + ahead] && aheadMoved[i] == moved[i + ahead];
+			} else if (i > 0) {
+				matches = matches && aheadStill[i] == still[i - 1] && aheadMoved[i] == moved[i - 1];
+			}
+		}
+		verified = verified && matches && lag < RUN_AHEAD_PROBE_FRAMES;
+
+		RunAheadImages(rom, start, ahead, INPUT_ALWAYS_ON | INPUT_P1_RIGHT, frames, seconds);
+
+		std::cout << "    { \"mode\": \"" << (ahead < 0 ? "queued" : "runAhead") << "\""
+			<< ", \"framesAhead\": " << std::max(ahead, 0)
+			<< ", \"lagFrames\": " << lag
+			<< ", \"effectiveLagFrames\": " << lag - std::max(ahead, 0)
+			<< ", \"microsecondsPerFrame\": " << seconds * 1000000.0 / frames;
+		EndRow(matches, ahead == MAX_RUN_AHEAD_FRAMES);
+	}
+
+	std::cout << "  ],\n";
+	return EndReport(verified);
+}
+
+//frames are run the way the window runs them, converting only the ones presented every fastForward frames
+//whatever the frame skip, the last image has to be the one presenting every frame ends on
+bool PrintFastForward(const std::vector<char>& rom, size_t frames, size_t) {
+	std::cout << "  \"modes\": [\n";
+
+	bool verified = true;
+	uint64_t expected = 0;
+	for (size_t fastForward = 1; fastForward <= FAST_FORWARD_MAX; fastForward *= 2) {
+		CPU cpu;
+		Display display(cpu);
+		cpu.LoadROM(rom.size(), rom.data());
+		FrameSkip frameSkip(fastForward);
+
+		auto begin = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < frames;) {
+			size_t count = std::min(frameSkip.NextFrames(std::chrono::steady_clock::now()), frames - i);
+			for (size_t j = 0; j < count; j++, i++) {
+				cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(i));
+				cpu.RunFrame();
+			}
+			display.ConvertImage();
+		}
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		uint64_t image = HashImage(display);
+		if (fastForward == 1) expected = image;
+		verified = verified && image == expected;
+
+		std::cout << "    { \"fastForward\": " << fastForward
+			<< ", \"framesPresented\": " << frameSkip.GetFramesPresented()
+			<< ", \"framesPerSecond\": " << frames / seconds
+			<< ", \"timesRealTime\": " << frames * static_cast<double>(FRAME_CYCLES) / CLOCK_RATE / seconds;
+		EndRow(image == expected, fastForward * 2 > FAST_FORWARD_MAX);
+	}
+	std::cout << "  ],\n";
+
+	//a present slower than a frame has to be made up by running more frames per present, keeping the game at full speed
+	CPU cpu;
+	Display display(cpu);
+	cpu.LoadROM(rom.size(), rom.data());
+	FrameSkip frameSkip(1, true);
+
+	size_t frame = 0;
+	auto begin = std::chrono::steady_clock::now();
+	auto now = begin;
+	for (; now - begin < std::chrono::duration<double>(ADAPTIVE_SECONDS); now = std::chrono::steady_clock::now()) {
+		size_t count = frameSkip.NextFrames(now);
+		for (size_t i = 0; i < count; i++) {
+			cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(frame++));
+			cpu.RunFrame();
+		}
+		display.ConvertImage();
+		std::this_thread::sleep_for(std::chrono::milliseconds(ADAPTIVE_PRESENT_MILLISECONDS));
+	}
+	double wallSeconds = std::chrono::duration<double>(now - begin).count();
+	double emulatedSeconds = static_cast<double>(frameSkip.GetFramesRun()) * FRAME_CYCLES / CLOCK_RATE;
+	double speed = emulatedSeconds / wallSeconds;
+	bool paced = speed > 0.9 && speed < 1.1 && frameSkip.GetFramesLost() == 0;
+	verified = verified && paced;
+
+	std::cout << "  \"adaptive\": { \"presentMilliseconds\": " << ADAPTIVE_PRESENT_MILLISECONDS
+		<< ", \"wallSeconds\": " << wallSeconds
+		<< ", \"emulatedSeconds\": " << emulatedSeconds
+		<< ", \"speed\": " << speed
+		<< ", \"framesRun\": " << frameSkip.GetFramesRun()
+		<< ", \"framesPresented\": " << frameSkip.GetFramesPresented()
+		<< ", \"framesLost\": " << frameSkip.GetFramesLost()
+		<< ", \"verified\": " << (paced ? "true" : "false") << " },\n";
+	return EndReport(verified);
+}
+
+//each speed is paced for PACER_BENCH_SECONDS of wall time, the busy share is the time spent running and spinning
+//a thread paced at real time should be idle nearly all of every frame
+bool PrintPacer(const std::vector<char>& rom, size_t, size_t) {
+	const double speeds[] = { 1.0, 2.0, 4.0 };
+	std::cout << "  \"speeds\": [\n";
+
+	bool verified = true;
+	for (size_t i = 0; i < 3; i++) {
+		CPU cpu;
+		cpu.LoadROM(rom.size(), rom.data());
+		FramePacer pacer(speeds[i]);
+		size_t frames = static_cast<size_t>(PACER_BENCH_SECONDS * CLOCK_RATE / FRAME_CYCLES * speeds[i]);
+
+		auto begin = std::chrono::steady_clock::now();
+		pacer.Start();
+		for (size_t frame = 0; frame < frames; frame++) {
+			cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(frame));
+			cpu.RunFrame();
+			pacer.Wait();
+		}
+		double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+		double emulatedSeconds = static_cast<double>(cpu.GetCycleCount()) / CLOCK_RATE;
+		double speed = emulatedSeconds / wallSeconds;
+		double busy = 1.0 - pacer.GetSleepSeconds() / wallSeconds;
+		bool paced = std::abs(speed / speeds[i] - 1.0) < 0.02 && pacer.GetResyncs() == 0;
+		verified = verified && paced;
+
+		std::cout << "    { \"speed\": " << speeds[i]
+			<< ", \"frames\": " << frames
+			<< ", \"wallSeconds\": " << wallSeconds
+			<< ", \"measuredSpeed\": " << speed
+			<< ", \"meanJitterMicroseconds\": " << pacer.GetMeanJitter()
+			<< ", \"maxJitterMicroseconds\": " << pacer.GetMaxJitter()
+			<< ", \"spinSeconds\": " << pacer.GetSpinSeconds()
+			<< ", \"busyFraction\": " << busy
+			<< ", \"resyncs\": " << pacer.GetResyncs();
+		EndRow(paced, i + 1 == 3);
+	}
+
+	std::cout << "  ],\n";
+	return EndReport(verified);
+}
+
+//the emulation thread runs frames flat out and publishes each, while this thread converts as fast as it can
+//every image converted has to be exactly the one a single thread shows after the same frame, or it was torn
+bool PrintHandoff(const std::vector<char>& rom, size_t frames, size_t) {
+	std::vector<uint64_t> expected;
+	{
+		CPU cpu;
+		Display display(cpu);
+		cpu.LoadROM(rom.size(), rom.data());
+		for (size_t i = 0; i < frames; i++) {
+			cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(i));
+			cpu.RunFrame();
+			display.ConvertImage();
+			expected.push_back(HashImage(display));
+		}
+	}
+
+	bool verified = true;
+	std::cout << "  \"runs\": [\n";
+	for (size_t run = 0; run < HANDOFF_RUNS; run++) {
+		CPU cpu;
+		Display display(cpu);
+		cpu.LoadROM(rom.size(), rom.data());
+		display.UsePublishedFrames();
+
+		std::atomic<bool> done{ false };
+		double publishSeconds = 0;
+		std::thread emulation([&] {
+			for (size_t i = 0; i < frames; i++) {
+				cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(i));
+				cpu.RunFrame();
+				auto begin = std::chrono::steady_clock::now();
+				display.Publish();
+				publishSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			}
+			done.store(true, std::memory_order_release);
+		});
+
+		size_t taken = 0;
+		size_t mismatched = 0;
+		double convertSeconds = 0;
+		bool finished = false;
+		while (!finished) {
+			finished = done.load(std::memory_order_acquire);
+			uint64_t last = display.GetFrameNumber();
+			auto begin = std::chrono::steady_clock::now();
+			display.ConvertImage();
+			if (display.GetFrameNumber() == last) continue;
+
+			convertSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			taken++;
+			if (HashImage(display) != expected[display.GetFrameNumber() - 1]) mismatched++;
+		}
+		emulation.join();
+
+		bool matches = mismatched == 0 && display.GetFrameNumber() == frames;
+		verified = verified && matches;
+
+		std::cout << "    { \"framesPublished\": " << frames
+			<< ", \"framesTaken\": " << taken
+			<< ", \"mismatched\": " << mismatched
+			<< ", \"publishNanoseconds\": " << publishSeconds * 1000000000.0 / frames
+			<< ", \"takeMicroseconds\": " << (taken ? convertSeconds * 1000000.0 / taken : 0.0);
+		EndRow(matches, run + 1 == HANDOFF_RUNS);
+	}
+
+	std::cout << "  ],\n";
+	return EndReport(verified);
+}
+
+void PrintResult(std::ostream& out, const RunResult& result, size_t frames) {
+	out << "{ \"seconds\": " << result.seconds
+		<< ", \"cpuSeconds\": " << result.cpuSeconds
+		<< ", \"displaySeconds\": " << result.displaySeconds
+		<< ", \"emulatedMHz\": " << result.cycles / result.seconds / 1000000.0
+		<< ", \"instructionsPerSecond\": " << result.instructions / result.seconds
+		<< ", \"framesPerSecond\": " << frames / result.seconds
+		<< ", \"instructions\": " << result.instructions << " }";
+}
+
+//engines that check a feature against plain runs as well as timing it, timed ones run for a set time whatever the frame count
+//they run once and take no run count, except the ones marked repeated, which report the median of runs
+struct Check {
+	const char* engine;
+	bool (*print)(const std::vector<char>& rom, size_t frames, size_t runs);
+	bool timed;
+	bool repeated;
+};
+
+static const Check checks[] = {
+	//the lockstep core is timed against as many scalar CPUs as it has lanes, and checked against them
+	{ "lockstep", PrintLockstep, false, false },
+	{ "snapshot", PrintSnapshot, false, true },
+	{ "rewind", PrintRewind, false, false },
+	{ "runahead", PrintRunAhead, false, false },
+	{ "fastforward", PrintFastForward, false, false },
+	{ "pacer", PrintPacer, true, false },
+	{ "handoff", PrintHandoff, false, false }
+};
+
+int main(int argc, char* args[]) {
+	std::string romName = argc > 1 ? args[1] : "invaders.rom";
+	size_t frames = argc > 2 ? std::stoul(args[2]) : 3600;
+	std::string engine = argc > 3 ? args[3] : "interpreter";
+	size_t runs = argc > 4 ? std::stoul(args[4]) : 5;
+	size_t warmups = argc > 5 ? std::stoul(args[5]) : 1;
+	size_t instances = argc > 6 ? std::stoul(args[6]) : 1;
+	size_t maxThreads = argc > 7 ? std::stoul(args[7]) : std::thread::hardware_concurrency();
+	if (runs == 0) runs = 1;
+	if (maxThreads == 0) maxThreads = 1;
+
+	std::vector<char> rom = LoadFile(romName);
+	if (rom.empty()) return EXIT_FAILURE;
+
+	for (const Check& check : checks) {
+		if (engine != check.engine) continue;
+		if (argc > 4 && !check.repeated) {
+			std::cerr << engine << " runs once and takes no run count\n";
+			return EXIT_FAILURE;
+		}
+		PrintHeader(romName, engine, check.timed ? 0 : frames);
+		return check.print(rom, frames, runs) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	//several instances measure how throughput scales with threads instead of single instance speed
+	if (instances > 1) {
+		PrintHeader(romName, engine, frames);
+		std::cout << "  \"warmups\": " << warmups << ",\n";
+		PrintScaling(rom, engine, instances, maxThreads, frames, runs, warmups);
+		return EXIT_SUCCESS;
+	}
+
+	std::unique_ptr<CPU> cpu;
+	std::vector<RunResult> results;
+	for (size_t i = 0; i < warmups + runs; i++) {
+		cpu.reset(new CPU());
+		RunResult result = Run(*cpu, rom, engine, frames);
+		if (i >= warmups) results.push_back(result);
+	}
+
+	if (engine == "jit" && !cpu->IsJitEnabled()) {
+		std::cerr << "JIT not supported in this build\n";
+	}
+	if (engine == "recompiled" && !cpu->IsRecompiledEnabled()) {
+		std::cerr << "no recompiled code for this ROM in this build\n";
+	}
+
+	//the median run is the one to compare across commits, the rest show the spread
+	std::vector<RunResult> sorted = results;
+	std::sort(sorted.begin(), sorted.end(), [](const RunResult& a, const RunResult& b) { return a.seconds < b.seconds; });
+
+	PrintHeader(romName, cpu->IsRecompiledEnabled() ? "recompiled" : cpu->IsJitEnabled() ? "jit" : "interpreter", frames);
+	std::cout << "  \"flags\": \"" << (CPU_LAZY_FLAGS ? "lazy" : "eager") << "\",\n";
+	std::cout << "  \"dispatch\": " << CPU_DISPATCH << ",\n";
+	std::cout << "  \"warmups\": " << warmups << ",\n";
+	std::cout << "  \"median\": ";
+	PrintResult(std::cout, sorted[sorted.size() / 2], frames);
+	std::cout << ",\n  \"runs\": [\n";
+	for (size_t i = 0; i < results.size(); i++) {
+		std::cout << "    ";
+		PrintResult(std::cout, results[i], frames);
+		std::cout << (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	std::cout << "  ]\n}\n";
+
+	//counters from the last run go to stderr, so stdout stays JSON
+#ifdef CPU_FLAG_STATS
+	//eager evaluation computes all four of Z, S, P and AC on every update
+	const CPU::FlagStats& stats = cpu->GetFlagStats();
+	std::cerr << "flag updates: " << stats.updates << "\n";
+	std::cerr << "flag materializations: " << stats.materializations << "\n";
+	if (stats.updates > 0) {
+		std::cerr << "flag work saved: " << 100.0 * (1.0 - static_cast<double>(stats.materializations) / (stats.updates * 4)) << "%\n";
+	}
+#endif
+
+#ifdef CPU_OPCODE_STATS
+	//candidates for fused handlers, only the interpreter counts them
+	double instructions = static_cast<double>(cpu->GetInstructionCount());
+	const CPU::OpcodeStats& opcodeStats = cpu->GetOpcodeStats();
+	std::vector<std::pair<uint32_t, uint64_t>> pairs;
+	for (uint32_t key = 0; key < opcodeStats.pairs.size(); key++) {
+		if (opcodeStats.pairs[key] > 0) pairs.emplace_back(key, opcodeStats.pairs[key]);
+	}
+	std::vector<std::pair<uint32_t, uint64_t>> triples(opcodeStats.triples.begin(), opcodeStats.triples.end());
+	PrintTopSequences("top opcode pairs", pairs, 2, instructions);
+	PrintTopSequences("top opcode triples", triples, 3, instructions);
+#endif
+
+	return EXIT_SUCCESS;
+}
@@ -1,3 +1,4 @@
+#include <string>
 #include <vector>
 
 std::string Disassemble(const std::vector<char>& buffer);
\ No newline at end of file
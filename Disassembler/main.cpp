@@ -1,31 +1,14 @@
 #include <string>
 #include <iostream>
-#include <fstream>
 #include <vector>
 
 #include "Disassemble.h"
-
-std::vector<char> ReadFile(const std::string& fileName) {
-	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
-	if (!file) {
-		std::cout << "Could not open \"" << fileName << "\"\n";
-		return {};
-	}
-
-	size_t size = file.tellg();
-
-	std::vector<char> buffer(size);
-
-	file.seekg(0, std::ios::beg);
-	file.read(buffer.data(), size);
-
-	return buffer;
-}
+#include "Utilities.h"
 
 int main(int argc, char* args[]) {
 	if (argc == 1) return EXIT_FAILURE;
 
-	std::vector<char> buffer = ReadFile(args[1]);
+	std::vector<char> buffer = LoadFile(args[1]);
 
 	std::cout << buffer.size() << " bytes\n";
 	std::cout << Disassemble(buffer) << "\n";
@@ -0,0 +1,185 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+
+#include "CPU.h"
+#include "Display.h"
+#include "SnapshotFile.h"
+#include "Movie.h"
+#include "InputScript.h"
+#include "FramePacer.h"
+#include "Utilities.h"
+
+//binary PPM, in the orientation the renderer uploads the image
+bool WriteImage(const std::string& fileName, const std::vector<Color4>& image) {
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file) {
+		std::cout << "Could not write \"" << fileName << "\"\n";
+		return false;
+	}
+
+	file << "P6\n" << IMAGE_WIDTH << " " << IMAGE_HEIGHT << "\n255\n";
+	for (const Color4& pixel : image) {
+		char rgb[3] = { static_cast<char>(pixel.r), static_cast<char>(pixel.g), static_cast<char>(pixel.b) };
+		file.write(rgb, 3);
+	}
+
+	return true;
+}
+
+int main(int argc, char* args[]) {
+	if (argc < 3) {
+		std::cout << "usage: Headless <rom> <frames> [--realtime] [--jit] [--dump image.ppm] [--load state] [--save state] [--script] [--record movie] [--replay movie]\n";
+		std::cout << "  --script plays the benchmark input script, --replay takes its frames from the movie\n";
+		return EXIT_FAILURE;
+	}
+
+	std::string romName = args[1];
+	size_t frames = std::stoul(args[2]);
+	bool realtime = false;
+	bool jit = false;
+	std::string dumpName;
+	std::string loadName;
+	std::string saveName;
+	bool script = false;
+	std::string recordName;
+	std::string replayName;
+
+	for (int i = 3; i < argc; i++) {
+		std::string arg = args[i];
+		if (arg == "--realtime") {
+			realtime = true;
+		} else if (arg == "--jit") {
+			jit = true;
+		} else if (arg == "--dump" && i + 1 < argc) {
+			dumpName = args[++i];
+		} else if (arg == "--load" && i + 1 < argc) {
+			loadName = args[++i];
+		} else if (arg == "--save" && i + 1 < argc) {
+			saveName = args[++i];
+		} else if (arg == "--script") {
+			script = true;
+		} else if (arg == "--record" && i + 1 < argc) {
+			recordName = args[++i];
+		} else if (arg == "--replay" && i + 1 < argc) {
+			replayName = args[++i];
+		} else {
+			std::cout << "Unknown option \"" << arg << "\"\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::vector<char> rom = LoadFile(romName);
+	if (rom.empty()) return EXIT_FAILURE;
+
+	CPU cpu;
+	Display display(cpu);
+	cpu.LoadROM(rom.size(), rom.data());
+	if (jit && !cpu.EnableJit(true)) {
+		std::cout << "JIT not supported in this build\n";
+	}
+
+	//frames count on from the snapshot, so a save after 600 frames and a load then 600 more matches a run of 1200
+	if (!loadName.empty()) {
+		Snapshot snapshot;
+		if (!ReadSnapshot(loadName, snapshot)) {
+			std::cout << "Could not load \"" << loadName << "\"\n";
+			return EXIT_FAILURE;
+		}
+		cpu.LoadState(snapshot);
+		display.Invalidate();
+	}
+	SnapshotWriter writer;
+
+	//a replay is never throttled, and fails the run if it doesn't end where the recording did
+	if (!replayName.empty()) {
+		Movie movie;
+		if (!movie.Load(replayName)) {
+			std::cout << "Could not load \"" << replayName << "\"\n";
+			return EXIT_FAILURE;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		bool matches = movie.Replay(cpu);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		display.Invalidate();
+
+		std::cout << "frames: " << movie.GetFrameCount() << "\n";
+		std::cout << "inputs: " << movie.GetEventCount() << "\n";
+		std::cout << "seconds: " << seconds << "\n";
+		std::cout << "speed: " << movie.GetFrameCount() * static_cast<double>(FRAME_CYCLES) / CLOCK_RATE / seconds << "x real time\n";
+		std::cout << "replay: " << (matches ? "matches the recording" : "differs from the recording") << "\n";
+
+		if (!dumpName.empty()) {
+			display.ConvertImage();
+			if (!WriteImage(dumpName, display.GetImage())) return EXIT_FAILURE;
+		}
+		return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	bool recording = !recordName.empty();
+	Movie movie;
+	if (recording) movie.Start(cpu);
+
+	//frames are counted in emulated cycles, the wall clock only throttles with --realtime, so every run with the same inputs is the same
+	FramePacer pacer;
+	auto start = std::chrono::steady_clock::now();
+	uint64_t startCycles = cpu.GetCycleCount();
+	if (realtime) pacer.Start();
+
+	for (size_t i = 0; i < frames; i++) {
+		if (script && recording) {
+			movie.SetInput(cpu, INPUT_PORT_PLAYER, ScriptedInput(i));
+		} else if (script) {
+			cpu.SetInput(INPUT_PORT_PLAYER, ScriptedInput(i));
+		}
+
+		if (recording) {
+			movie.RunFrame(cpu);
+		} else {
+			cpu.RunFrame();
+		}
+
+		if (realtime) {
+			pacer.Wait();
+		}
+	}
+
+	if (recording) {
+		movie.Finish(cpu);
+		if (!movie.Save(recordName)) {
+			std::cout << "Could not write \"" << recordName << "\"\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!saveName.empty()) {
+		Snapshot snapshot = {};
+		cpu.SaveState(snapshot);
+		writer.Save(saveName, snapshot, true);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	double emulatedSeconds = static_cast<double>(cpu.GetCycleCount() - startCycles) / CLOCK_RATE;
+
+	std::cout << "frames: " << frames << "\n";
+	std::cout << "seconds: " << seconds << "\n";
+	std::cout << "speed: " << emulatedSeconds / seconds << "x real time\n";
+	if (realtime) {
+		std::cout << "jitter: mean " << pacer.GetMeanJitter() << " us, max " << pacer.GetMaxJitter() << " us\n";
+	}
+
+	if (!writer.Flush()) {
+		std::cout << "Could not write \"" << saveName << "\"\n";
+		return EXIT_FAILURE;
+	}
+
+	if (!dumpName.empty()) {
+		display.ConvertImage();
+		if (!WriteImage(dumpName, display.GetImage())) return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
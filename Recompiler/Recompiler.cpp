@@ -0,0 +1,382 @@
+#include "Recompiler.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include "CPU.h"
+#include "Recompiled.h"
+
+//operand names in the order of the 8080's 3-bit register field
+static const char* const registers[8] = { "r.b", "r.c", "r.d", "r.e", "r.h", "r.l", "r.M()", "r.a" };
+static const char* const pairs[3] = { "BC", "DE", "HL" };
+static const char* const operations[8] = { "ADD", "ADC", "SUB", "SBB", "ANA", "XRA", "ORA", "CMP" };
+static const char* const conditions[8] = { "!r.Zero()", "r.Zero()", "!r.Carry()", "r.Carry()", "!r.Parity()", "r.Parity()", "!r.Sign()", "r.Sign()" };
+
+Recompiler::Recompiler(const std::vector<uint8_t>& data) : rom(data) {
+	if (rom.size() > ROM_SIZE) rom.resize(ROM_SIZE);
+	code.assign(rom.size(), 0);
+	entries.assign(rom.size(), 0);
+}
+
+//opcodes CPU::Execute doesn't handle are left to the interpreter, which reports them
+bool Recompiler::Implemented(uint8_t opcode) {
+	switch (opcode) {
+		case 0x10: case 0x18: case 0x28: case 0x30: case 0x38:
+		case 0x76: case 0xCB: case 0xD9: case 0xDD: case 0xED: case 0xF9: case 0xFD:
+			return false;
+		default:
+			return true;
+	}
+}
+
+//JMP, RET, PCHL, CALL and RST never go on to the next instruction themselves
+bool Recompiler::FallsThrough(uint8_t opcode) {
+	if (opcode == 0xC3 || opcode == 0xC9 || opcode == 0xE9 || opcode == 0xCD) return false;
+	return (opcode & 0xC7) != 0xC7;
+}
+
+bool Recompiler::Decodable(uint16_t pc) const {
+	return pc < rom.size() && Implemented(rom[pc]) && pc + lengthTable.entries[rom[pc]] <= rom.size();
+}
+
+bool Recompiler::IsCode(uint32_t pc) const {
+	return pc < code.size() && code[pc];
+}
+
+void Recompiler::MarkEntry(uint16_t pc) {
+	if (pc < entries.size()) entries[pc] = 1;
+}
+
+uint16_t Recompiler::Word(uint16_t pc) const {
+	return static_cast<uint16_t>(rom[pc + 1] | (rom[pc + 2] << 8));
+}
+
+//recursive descent from reset and the RST vectors, the video interrupts come in through RST 1 and RST 2
+void Recompiler::Discover() {
+	std::vector<uint16_t> pending;
+	for (uint16_t vector = 0; vector < 0x40; vector += 8) {
+		MarkEntry(vector);
+		pending.push_back(vector);
+	}
+
+	while (!pending.empty()) {
+		uint16_t pc = pending.back();
+		pending.pop_back();
+		if (IsCode(pc) || !Decodable(pc)) continue;
+
+		code[pc] = 1;
+		instructionCount++;
+
+		uint8_t opcode = rom[pc];
+		uint16_t next = static_cast<uint16_t>(pc + lengthTable.entries[opcode]);
+		//CALL and RST come back to the next instruction through RET
+		if (opcode != 0xC3 && opcode != 0xC9 && opcode != 0xE9) {
+			pending.push_back(next);
+		}
+		//a branch charges cycles only for what it runs, so whatever follows starts a new block
+		if (opcodeTable.entries[opcode].endsBlock) {
+			MarkEntry(next);
+		}
+
+		if ((opcode & 0xC7) == 0xC7) {
+			MarkEntry(opcode & 0x38);
+			pending.push_back(opcode & 0x38);
+		} else if (opcode == 0xC3 || opcode == 0xCD || (opcode & 0xC7) == 0xC2 || (opcode & 0xC7) == 0xC4) {
+			MarkEntry(Word(pc));
+			pending.push_back(Word(pc));
+		}
+	}
+
+	//falling through to anything but the next instruction in address order, which only happens when
+	//decoded instructions overlap, needs a goto and so a label
+	for (uint32_t pc = 0; pc < code.size(); pc++) {
+		if (!code[pc] || !FallsThrough(rom[pc])) continue;
+		uint32_t next = pc + lengthTable.entries[rom[pc]];
+		for (uint32_t inside = pc + 1; inside < next; inside++) {
+			if (IsCode(inside)) {
+				MarkEntry(static_cast<uint16_t>(next));
+				break;
+			}
+		}
+	}
+
+	entryCount = 0;
+	for (size_t pc = 0; pc < code.size(); pc++) {
+		if (!code[pc]) entries[pc] = 0;
+		entryCount += entries[pc];
+	}
+}
+
+//a block runs from its entry to the next branch or entry, whichever comes first
+void Recompiler::BlockSize(uint16_t pc, uint32_t& cycles, uint32_t& count) const {
+	cycles = 0;
+	count = 0;
+	for (;;) {
+		uint8_t opcode = rom[pc];
+		cycles += cycleTable.entries[opcode];
+		count++;
+		if (opcodeTable.entries[opcode].endsBlock) return;
+
+		uint16_t next = static_cast<uint16_t>(pc + lengthTable.entries[opcode]);
+		if (!IsCode(next) || entries[next]) return;
+		pc = next;
+	}
+}
+
+std::string Recompiler::Hex(uint32_t value, int digits) {
+	std::ostringstream text;
+	text << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+	return text.str();
+}
+
+std::string Recompiler::Label(uint16_t pc) {
+	std::ostringstream text;
+	text << "L" << std::uppercase << std::hex << std::setw(4) << std::setfill('0') << pc;
+	return text.str();
+}
+
+//targets outside the recompiled code go back to CPU::Run, which interprets them
+void Recompiler::EmitJump(std::ostream& out, uint16_t target, const char* indent) {
+	if (IsCode(target)) {
+		out << indent << "goto " << Label(target) << ";\n";
+	} else {
+		out << indent << "pc = " << Hex(target, 4) << ";\n";
+		out << indent << "goto leave;\n";
+	}
+}
+
+//M is written through the bus rather than assigned
+void Recompiler::EmitAssign(std::ostream& out, uint8_t reg, const std::string& value) {
+	if (reg == 6) out << "\tr.SetM(" << value << ");\n";
+	else out << "\t" << registers[reg] << " = " << value << ";\n";
+}
+
+void Recompiler::EmitInstruction(std::ostream& out, uint16_t pc) {
+	uint8_t opcode = rom[pc];
+	uint8_t length = lengthTable.entries[opcode];
+	uint16_t next = static_cast<uint16_t>(pc + length);
+	std::string byte = length > 1 ? Hex(rom[pc + 1], 2) : "";
+	std::string word = length > 2 ? Hex(Word(pc), 4) : "";
+	const char* destination = registers[(opcode >> 3) & 7];
+	const char* source = registers[opcode & 7];
+	uint8_t pair = (opcode >> 4) & 3;
+	const char* condition = conditions[(opcode >> 3) & 7];
+
+	out << "\t//" << Hex(pc, 4).substr(2) << ":";
+	for (int i = 0; i < length; i++) {
+		out << " " << Hex(rom[pc + i], 2).substr(2);
+	}
+	out << "  " << FormatInstruction(&rom[pc]) << "\n";
+
+	if (opcode >= 0x40 && opcode < 0x80) {	//MOV
+		if ((opcode & 7) != ((opcode >> 3) & 7)) {
+			EmitAssign(out, (opcode >> 3) & 7, source);
+		}
+	} else if (opcode >= 0x80 && opcode < 0xC0) {	//ALU r
+		out << "\tr." << operations[(opcode >> 3) & 7] << "(" << source << ");\n";
+	} else if ((opcode & 0xC7) == 0xC6) {	//ALU immediate
+		out << "\tr." << operations[(opcode >> 3) & 7] << "(" << byte << ");\n";
+	} else if ((opcode & 0xC7) == 0x04 || (opcode & 0xC7) == 0x05) {	//INR, DCR
+		const char* operation = (opcode & 1) ? "DCR" : "INR";
+		if (((opcode >> 3) & 7) == 6) {
+			out << "\tr.SetM(r." << operation << "(r.M()));\n";
+		} else {
+			out << "\t" << destination << " = r." << operation << "(" << destination << ");\n";
+		}
+	} else if ((opcode & 0xC7) == 0x06) {	//MVI
+		EmitAssign(out, (opcode >> 3) & 7, byte);
+	} else if ((opcode & 0xCF) == 0x01) {	//LXI
+		if (pair == 3) out << "\tr.sp = " << word << ";\n";
+		else out << "\tr.Set" << pairs[pair] << "(" << word << ");\n";
+	} else if ((opcode & 0xCF) == 0x09) {	//DAD
+		if (pair == 3) out << "\tr.DAD(r.sp);\n";
+		else out << "\tr.DAD(r." << pairs[pair] << "());\n";
+	} else if ((opcode & 0xCF) == 0x03 || (opcode & 0xCF) == 0x0B) {	//INX, DCX
+		const char* delta = (opcode & 8) ? "- 1" : "+ 1";
+		if (pair == 3) out << "\tr.sp = static_cast<uint16_t>(r.sp " << delta << ");\n";
+		else out << "\tr.Set" << pairs[pair] << "(static_cast<uint16_t>(r." << pairs[pair] << "() " << delta << "));\n";
+	} else if ((opcode & 0xCF) == 0xC1) {	//POP
+		if (pair == 3) out << "\tr.PopPSW();\n";
+		else out << "\tr.Set" << pairs[pair] << "(r.Pop());\n";
+	} else if ((opcode & 0xCF) == 0xC5) {	//PUSH
+		if (pair == 3) out << "\tr.PushPSW();\n";
+		else out << "\tr.Push(r." << pairs[pair] << "());\n";
+	} else if ((opcode & 0xC7) == 0xC2) {	//Jcc
+		out << "\tif (" << condition << ") {\n";
+		EmitJump(out, Word(pc), "\t\t");
+		out << "\t}\n";
+	} else if ((opcode & 0xC7) == 0xC4) {	//Ccc
+		out << "\tif (" << condition << ") {\n";
+		out << "\t\tcycles += " << static_cast<int>(opcodeTable.entries[opcode].takenCycles) << ";\n";
+		out << "\t\tr.Push(" << Hex(next, 4) << ");\n";
+		EmitJump(out, Word(pc), "\t\t");
+		out << "\t}\n";
+	} else if ((opcode & 0xC7) == 0xC0) {	//Rcc
+		out << "\tif (" << condition << ") {\n";
+		out << "\t\tcycles += " << static_cast<int>(opcodeTable.entries[opcode].takenCycles) << ";\n";
+		out << "\t\tpc = r.Pop();\n";
+		out << "\t\tgoto dispatch;\n";
+		out << "\t}\n";
+	} else if ((opcode & 0xC7) == 0xC7) {	//RST
+		out << "\tr.Push(" << Hex(next, 4) << ");\n";
+		EmitJump(out, opcode & 0x38, "\t");
+	} else {
+		switch (opcode) {
+			case 0x00:	//NOP
+			case 0x08:
+			case 0x20:
+				break;
+			case 0x02:	//STAX B
+			case 0x12:	//STAX D
+				out << "\tr.Write(r." << pairs[pair] << "(), r.a);\n";
+				break;
+			case 0x0A:	//LDAX B
+			case 0x1A:	//LDAX D
+				out << "\tr.a = r.Read(r." << pairs[pair] << "());\n";
+				break;
+			case 0x07:	//RLC
+				out << "\tr.SetCarry(r.a >> 7);\n";
+				out << "\tr.a = static_cast<uint8_t>((r.a << 1) | (r.a >> 7));\n";
+				break;
+			case 0x0F:	//RRC
+				out << "\tr.SetCarry(r.a & 1);\n";
+				out << "\tr.a = static_cast<uint8_t>((r.a >> 1) | (r.a << 7));\n";
+				break;
+			case 0x17:	//RAL
+				out << "\t{\n\t\tuint8_t carry = r.Carry();\n\t\tr.SetCarry(r.a >> 7);\n";
+				out << "\t\tr.a = static_cast<uint8_t>((r.a << 1) | carry);\n\t}\n";
+				break;
+			case 0x1F:	//RAR
+				out << "\t{\n\t\tuint8_t carry = r.Carry();\n\t\tr.SetCarry(r.a & 1);\n";
+				out << "\t\tr.a = static_cast<uint8_t>((r.a >> 1) | (carry << 7));\n\t}\n";
+				break;
+			case 0x22:	//SHLD
+				out << "\tr.Write(" << word << ", r.l);\n";
+				out << "\tr.Write(" << Hex(static_cast<uint16_t>(Word(pc) + 1), 4) << ", r.h);\n";
+				break;
+			case 0x2A:	//LHLD
+				out << "\tr.l = r.Read(" << word << ");\n";
+				out << "\tr.h = r.Read(" << Hex(static_cast<uint16_t>(Word(pc) + 1), 4) << ");\n";
+				break;
+			case 0x27:	//DAA
+				out << "\tr.DAA();\n";
+				break;
+			case 0x2F:	//CMA
+				out << "\tr.a = static_cast<uint8_t>(~r.a);\n";
+				break;
+			case 0x32:	//STA
+				out << "\tr.Write(" << word << ", r.a);\n";
+				break;
+			case 0x3A:	//LDA
+				out << "\tr.a = r.Read(" << word << ");\n";
+				break;
+			case 0x37:	//STC
+				out << "\tr.f |= FLAG_CY;\n";
+				break;
+			case 0x3F:	//CMC
+				out << "\tr.f ^= FLAG_CY;\n";
+				break;
+			case 0xC3:	//JMP
+				EmitJump(out, Word(pc), "\t");
+				break;
+			case 0xC9:	//RET
+				out << "\tpc = r.Pop();\n";
+				out << "\tgoto dispatch;\n";
+				break;
+			case 0xCD:	//CALL
+				out << "\tr.Push(" << Hex(next, 4) << ");\n";
+				EmitJump(out, Word(pc), "\t");
+				break;
+			case 0xD3:	//OUT
+				out << "\tWriteOutput(" << byte << ", r.a);\n";
+				break;
+			case 0xDB:	//IN
+				out << "\tr.a = ReadInput(" << byte << ");\n";
+				break;
+			case 0xE3:	//XTHL
+				out << "\tr.XTHL();\n";
+				break;
+			case 0xE9:	//PCHL
+				out << "\tpc = r.HL();\n";
+				out << "\tgoto dispatch;\n";
+				break;
+			case 0xEB:	//XCHG
+				out << "\tr.XCHG();\n";
+				break;
+			case 0xF3:	//DI
+				out << "\tstate.interruptEnable = 0;\n";
+				break;
+			case 0xFB:	//EI
+				out << "\tstate.interruptEnable = 1;\n";
+				break;
+		}
+	}
+
+	if (!FallsThrough(opcode)) return;
+
+	uint32_t following = pc + 1;
+	while (following < code.size() && !code[following]) following++;
+	if (following != next || !IsCode(next)) {
+		EmitJump(out, next, "\t");
+	}
+}
+
+void Recompiler::Generate(std::ostream& out, const std::string& romName) {
+	out << "//generated by Recompiler from " << romName << ", do not edit\n";
+	out << "#include \"CPU.h\"\n\n";
+	out << "#if CPU_RECOMPILED\n\n";
+	out << "#include \"Recompiled.h\"\n\n";
+
+	out << "bool CPU::MatchesRecompiledROM() const {\n";
+	out << "\treturn HashROM(state.memory.data(), " << Hex(static_cast<uint32_t>(rom.size()), 4) << ") == ";
+	std::ostringstream hash;
+	hash << "0x" << std::uppercase << std::hex << std::setw(16) << std::setfill('0') << HashROM(rom.data(), rom.size()) << "ULL";
+	out << hash.str() << ";\n";
+	out << "}\n\n";
+
+	out << "//runs whole blocks until the next one would pass target, or until pc leaves the recompiled code\n";
+	out << "void CPU::RunRecompiled(uint64_t target) {\n";
+	out << "\tRecompiledState r;\n";
+	out << "\tr.Load(state, bus);\n";
+	out << "\tuint16_t pc = state.pc;\n";
+	out << "\tuint64_t cycles = cycleCount;\n";
+	out << "\tuint64_t instructions = instructionCount;\n\n";
+
+	out << "dispatch:\n";
+	out << "\tswitch (pc) {\n";
+	for (uint32_t pc = 0; pc < code.size(); pc++) {
+		if (entries[pc]) {
+			out << "\t\tcase " << Hex(pc, 4) << ": goto " << Label(static_cast<uint16_t>(pc)) << ";\n";
+		}
+	}
+	out << "\t\tdefault: goto leave;\n";
+	out << "\t}\n";
+
+	for (uint32_t pc = 0; pc < code.size(); pc++) {
+		if (!code[pc]) continue;
+
+		if (entries[pc]) {
+			uint32_t blockCycles;
+			uint32_t blockCount;
+			BlockSize(static_cast<uint16_t>(pc), blockCycles, blockCount);
+
+			out << "\n" << Label(static_cast<uint16_t>(pc)) << ":\n";
+			out << "\tif (cycles + " << blockCycles << " > target) {\n";
+			out << "\t\tpc = " << Hex(pc, 4) << ";\n";
+			out << "\t\tgoto leave;\n";
+			out << "\t}\n";
+			out << "\tcycles += " << blockCycles << ";\n";
+			out << "\tinstructions += " << blockCount << ";\n";
+		}
+
+		EmitInstruction(out, static_cast<uint16_t>(pc));
+	}
+
+	out << "\nleave:\n";
+	out << "\tr.Store(state);\n";
+	out << "\tstate.pc = pc;\n";
+	out << "\tcycleCount = cycles;\n";
+	out << "\tinstructionCount = instructions;\n";
+	out << "}\n\n";
+	out << "#endif\n";
+}
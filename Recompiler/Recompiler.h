@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <ostream>
+
+//translates the code reachable in a ROM into one C++ function, CPU::RunRecompiled
+class Recompiler {
+public:
+	Recompiler(const std::vector<uint8_t>& rom);
+
+	void Discover();
+	void Generate(std::ostream& out, const std::string& romName);
+
+	size_t GetInstructionCount() const { return instructionCount; }
+	size_t GetEntryCount() const { return entryCount; }
+
+private:
+	std::vector<uint8_t> rom;
+	//1 where a decoded instruction starts
+	std::vector<uint8_t> code;
+	//1 where a block starts, these get a label and a case in the dispatch switch
+	std::vector<uint8_t> entries;
+	size_t instructionCount = 0;
+	size_t entryCount = 0;
+
+	bool Decodable(uint16_t pc) const;
+	bool IsCode(uint32_t pc) const;
+	void MarkEntry(uint16_t pc);
+	void BlockSize(uint16_t pc, uint32_t& cycles, uint32_t& count) const;
+	uint16_t Word(uint16_t pc) const;
+
+	void EmitInstruction(std::ostream& out, uint16_t pc);
+	void EmitJump(std::ostream& out, uint16_t target, const char* indent);
+	static void EmitAssign(std::ostream& out, uint8_t reg, const std::string& value);
+	static std::string Hex(uint32_t value, int digits);
+	static std::string Label(uint16_t pc);
+	static bool FallsThrough(uint8_t opcode);
+	static bool Implemented(uint8_t opcode);
+};
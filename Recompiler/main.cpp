@@ -0,0 +1,37 @@
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "Recompiler.h"
+#include "Utilities.h"
+
+//usage: Recompiler invaders.rom Recompiled.cpp
+int main(int argc, char* args[]) {
+	if (argc < 3) {
+		std::cout << "usage: Recompiler <rom> <output.cpp>\n";
+		return EXIT_FAILURE;
+	}
+
+	std::vector<char> file = LoadFile(args[1]);
+	if (file.empty()) return EXIT_FAILURE;
+	std::vector<uint8_t> rom(file.begin(), file.end());
+
+	Recompiler recompiler(rom);
+	recompiler.Discover();
+
+	std::ofstream out(args[2], std::ios::binary);
+	if (!out) {
+		std::cout << "Could not write \"" << args[2] << "\"\n";
+		return EXIT_FAILURE;
+	}
+
+	std::string romName = args[1];
+	size_t slash = romName.find_last_of("/\\");
+	if (slash != std::string::npos) romName = romName.substr(slash + 1);
+
+	recompiler.Generate(out, romName);
+
+	std::cout << recompiler.GetInstructionCount() << " instructions, " << recompiler.GetEntryCount() << " blocks\n";
+	return EXIT_SUCCESS;
+}
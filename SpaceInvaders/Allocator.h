@@ -2,7 +2,7 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 
-#include "Utilities.h"
+#include "VulkanUtilities.h"
 
 struct Allocation {
 	VkDeviceMemory memory;
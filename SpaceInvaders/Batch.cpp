@@ -0,0 +1,101 @@
+#include "Batch.h"
+#include <algorithm>
+
+Batch::Batch(const std::vector<char>& rom, size_t instanceCount, size_t threads) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = std::max<size_t>(1, std::min(threads, instanceCount));
+
+	instances.reserve(instanceCount);
+	for (size_t i = 0; i < instanceCount; i++) {
+		instances.emplace_back(new Instance());
+		instances.back()->cpu.LoadROM(rom.size(), rom.data());
+	}
+
+	shards = std::vector<Shard>(threads);
+	for (size_t i = 1; i < threads; i++) {
+		workers.emplace_back([this, i] {
+			Work(i);
+		});
+	}
+}
+
+Batch::~Batch() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	startSignal.notify_all();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+void Batch::Step(size_t frames, bool convertImages) {
+	//the shards are published to the workers by the mutex below
+	size_t count = shards.size();
+	for (size_t i = 0; i < count; i++) {
+		shards[i].next.store(instances.size() * i / count, std::memory_order_relaxed);
+		shards[i].end = instances.size() * (i + 1) / count;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stepFrames = frames;
+		stepConvert = convertImages;
+		busyWorkers = workers.size();
+		generation++;
+	}
+	startSignal.notify_all();
+
+	RunShards(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	doneSignal.wait(lock, [this] { return busyWorkers == 0; });
+}
+
+void Batch::Work(size_t thread) {
+	uint64_t seen = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			startSignal.wait(lock, [&] { return stopping || generation != seen; });
+			if (stopping) return;
+			seen = generation;
+		}
+
+		RunShards(thread);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--busyWorkers == 0) doneSignal.notify_one();
+	}
+}
+
+//drain this thread's own shard, then steal what is left of the others
+void Batch::RunShards(size_t thread) {
+	size_t count = shards.size();
+
+	for (size_t i = 0; i < count; i++) {
+		Shard& shard = shards[(thread + i) % count];
+
+		while (true) {
+			size_t first = shard.next.fetch_add(BATCH_CHUNK, std::memory_order_relaxed);
+			if (first >= shard.end) break;
+
+			size_t last = std::min(first + BATCH_CHUNK, shard.end);
+			for (size_t j = first; j < last; j++) {
+				StepInstance(*instances[j]);
+			}
+		}
+	}
+}
+
+void Batch::StepInstance(Instance& instance) {
+	for (size_t i = 0; i < stepFrames; i++) {
+		instance.cpu.AddFrame();
+		instance.cpu.Run(FRAME_CYCLES);
+	}
+
+	if (stepConvert) instance.display.ConvertImage();
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "CPU.h"
+#include "Display.h"
+
+#define CACHE_LINE_SIZE 64
+//instances a thread claims at a time, small enough that the last few get shared out evenly
+#define BATCH_CHUNK 4
+
+//many independent machines stepped together on a pool of threads
+class Batch {
+public:
+	//threads of 0 uses one per hardware thread, the calling thread counts as one of them
+	Batch(const std::vector<char>& rom, size_t instances, size_t threads = 0);
+	~Batch();
+
+	//runs every instance for frames frames, converting the images afterwards if asked
+	//inputs set on the CPUs before the call hold for all of its frames
+	void Step(size_t frames = 1, bool convertImages = false);
+
+	size_t GetSize() const { return instances.size(); }
+	size_t GetThreadCount() const { return shards.size(); }
+	CPU& GetCPU(size_t index) { return instances[index]->cpu; }
+	Display& GetDisplay(size_t index) { return instances[index]->display; }
+
+private:
+	//aligned so no two instances, which different threads write, share a cache line
+	struct alignas(CACHE_LINE_SIZE) Instance {
+		CPU cpu;
+		Display display;
+
+		Instance() : display(cpu) {}
+	};
+
+	//a contiguous range of instances, run by its own thread until others run dry and steal from it
+	struct alignas(CACHE_LINE_SIZE) Shard {
+		std::atomic<size_t> next{ 0 };
+		size_t end = 0;
+	};
+
+	std::vector<std::unique_ptr<Instance>> instances;
+	std::vector<Shard> shards;
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable startSignal;
+	std::condition_variable doneSignal;
+	uint64_t generation = 0;
+	size_t busyWorkers = 0;
+	bool stopping = false;
+	size_t stepFrames = 0;
+	bool stepConvert = false;
+
+	void Work(size_t thread);
+	void RunShards(size_t thread);
+	void StepInstance(Instance& instance);
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+//a vector of bytes as wide as the build targets: AVX-512BW, AVX2, or the SSE2 every x64 host has
+#if defined(__AVX512BW__)
+#define BYTE_VECTOR_SIZE 64
+#elif defined(__AVX2__)
+#define BYTE_VECTOR_SIZE 32
+#else
+#define BYTE_VECTOR_SIZE 16
+#endif
+
+struct ByteVector {
+#if BYTE_VECTOR_SIZE == 64
+	__m512i value;
+#elif BYTE_VECTOR_SIZE == 32
+	__m256i value;
+#else
+	__m128i value;
+#endif
+
+	//data is aligned to BYTE_VECTOR_SIZE
+	static ByteVector Load(const uint8_t* data);
+	static ByteVector Set(uint8_t byte);
+	void Store(uint8_t* data) const;
+};
+
+#if BYTE_VECTOR_SIZE == 64
+
+inline ByteVector ByteVector::Load(const uint8_t* data) { return { _mm512_load_si512(data) }; }
+inline ByteVector ByteVector::Set(uint8_t byte) { return { _mm512_set1_epi8(static_cast<char>(byte)) }; }
+inline void ByteVector::Store(uint8_t* data) const { _mm512_store_si512(data, value); }
+
+inline ByteVector operator+(ByteVector a, ByteVector b) { return { _mm512_add_epi8(a.value, b.value) }; }
+inline ByteVector operator-(ByteVector a, ByteVector b) { return { _mm512_sub_epi8(a.value, b.value) }; }
+inline ByteVector operator&(ByteVector a, ByteVector b) { return { _mm512_and_si512(a.value, b.value) }; }
+inline ByteVector operator|(ByteVector a, ByteVector b) { return { _mm512_or_si512(a.value, b.value) }; }
+inline ByteVector operator^(ByteVector a, ByteVector b) { return { _mm512_xor_si512(a.value, b.value) }; }
+//~a & b
+inline ByteVector AndNot(ByteVector a, ByteVector b) { return { _mm512_andnot_si512(a.value, b.value) }; }
+inline ByteVector AddSaturate(ByteVector a, ByteVector b) { return { _mm512_adds_epu8(a.value, b.value) }; }
+inline ByteVector SubtractSaturate(ByteVector a, ByteVector b) { return { _mm512_subs_epu8(a.value, b.value) }; }
+inline ByteVector Equal(ByteVector a, ByteVector b) { return { _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(a.value, b.value)) }; }
+//0xFF where bit 7 is set
+inline ByteVector Negative(ByteVector a) { return { _mm512_movm_epi8(_mm512_movepi8_mask(a.value)) }; }
+//bit 7 of each byte, byte 0 in bit 0
+inline uint64_t Bits(ByteVector a) { return _mm512_movepi8_mask(a.value); }
+template <int N>
+inline ByteVector ShiftWordsRight(ByteVector a) { return { _mm512_srli_epi16(a.value, N) }; }
+template <int N>
+inline ByteVector ShiftWordsLeft(ByteVector a) { return { _mm512_slli_epi16(a.value, N) }; }
+
+#elif BYTE_VECTOR_SIZE == 32
+
+inline ByteVector ByteVector::Load(const uint8_t* data) { return { _mm256_load_si256(reinterpret_cast<const __m256i*>(data)) }; }
+inline ByteVector ByteVector::Set(uint8_t byte) { return { _mm256_set1_epi8(static_cast<char>(byte)) }; }
+inline void ByteVector::Store(uint8_t* data) const { _mm256_store_si256(reinterpret_cast<__m256i*>(data), value); }
+
+inline ByteVector operator+(ByteVector a, ByteVector b) { return { _mm256_add_epi8(a.value, b.value) }; }
+inline ByteVector operator-(ByteVector a, ByteVector b) { return { _mm256_sub_epi8(a.value, b.value) }; }
+inline ByteVector operator&(ByteVector a, ByteVector b) { return { _mm256_and_si256(a.value, b.value) }; }
+inline ByteVector operator|(ByteVector a, ByteVector b) { return { _mm256_or_si256(a.value, b.value) }; }
+inline ByteVector operator^(ByteVector a, ByteVector b) { return { _mm256_xor_si256(a.value, b.value) }; }
+inline ByteVector AndNot(ByteVector a, ByteVector b) { return { _mm256_andnot_si256(a.value, b.value) }; }
+inline ByteVector AddSaturate(ByteVector a, ByteVector b) { return { _mm256_adds_epu8(a.value, b.value) }; }
+inline ByteVector SubtractSaturate(ByteVector a, ByteVector b) { return { _mm256_subs_epu8(a.value, b.value) }; }
+inline ByteVector Equal(ByteVector a, ByteVector b) { return { _mm256_cmpeq_epi8(a.value, b.value) }; }
+inline ByteVector Negative(ByteVector a) { return { _mm256_cmpgt_epi8(_mm256_setzero_si256(), a.value) }; }
+inline uint64_t Bits(ByteVector a) { return static_cast<uint32_t>(_mm256_movemask_epi8(a.value)); }
+template <int N>
+inline ByteVector ShiftWordsRight(ByteVector a) { return { _mm256_srli_epi16(a.value, N) }; }
+template <int N>
+inline ByteVector ShiftWordsLeft(ByteVector a) { return { _mm256_slli_epi16(a.value, N) }; }
+
+#else
+
+inline ByteVector ByteVector::Load(const uint8_t* data) { return { _mm_load_si128(reinterpret_cast<const __m128i*>(data)) }; }
+inline ByteVector ByteVector::Set(uint8_t byte) { return { _mm_set1_epi8(static_cast<char>(byte)) }; }
+inline void ByteVector::Store(uint8_t* data) const { _mm_store_si128(reinterpret_cast<__m128i*>(data), value); }
+
+inline ByteVector operator+(ByteVector a, ByteVector b) { return { _mm_add_epi8(a.value, b.value) }; }
+inline ByteVector operator-(ByteVector a, ByteVector b) { return { _mm_sub_epi8(a.value, b.value) }; }
+inline ByteVector operator&(ByteVector a, ByteVector b) { return { _mm_and_si128(a.value, b.value) }; }
+inline ByteVector operator|(ByteVector a, ByteVector b) { return { _mm_or_si128(a.value, b.value) }; }
+inline ByteVector operator^(ByteVector a, ByteVector b) { return { _mm_xor_si128(a.value, b.value) }; }
+inline ByteVector AndNot(ByteVector a, ByteVector b) { return { _mm_andnot_si128(a.value, b.value) }; }
+inline ByteVector AddSaturate(ByteVector a, ByteVector b) { return { _mm_adds_epu8(a.value, b.value) }; }
+inline ByteVector SubtractSaturate(ByteVector a, ByteVector b) { return { _mm_subs_epu8(a.value, b.value) }; }
+inline ByteVector Equal(ByteVector a, ByteVector b) { return { _mm_cmpeq_epi8(a.value, b.value) }; }
+inline ByteVector Negative(ByteVector a) { return { _mm_cmplt_epi8(a.value, _mm_setzero_si128()) }; }
+inline uint64_t Bits(ByteVector a) { return static_cast<uint32_t>(_mm_movemask_epi8(a.value)); }
+template <int N>
+inline ByteVector ShiftWordsRight(ByteVector a) { return { _mm_srli_epi16(a.value, N) }; }
+template <int N>
+inline ByteVector ShiftWordsLeft(ByteVector a) { return { _mm_slli_epi16(a.value, N) }; }
+
+#endif
+
+//everything below is built from the operations above
+
+inline ByteVector operator~(ByteVector a) { return a ^ ByteVector::Set(0xFF); }
+inline ByteVector NotEqual(ByteVector a, ByteVector b) { return ~Equal(a, b); }
+
+//a where mask is 0xFF, b where it is 0
+inline ByteVector Select(ByteVector mask, ByteVector a, ByteVector b) { return (mask & a) | AndNot(mask, b); }
+
+//0xFF where a + b carries out of the byte
+inline ByteVector Carry(ByteVector a, ByteVector b) { return NotEqual(AddSaturate(a, b), a + b); }
+
+//0xFF where a < b, unsigned
+inline ByteVector Below(ByteVector a, ByteVector b) { return NotEqual(SubtractSaturate(b, a), ByteVector::Set(0)); }
+
+//there are no byte shifts, so shift the words and clear what crossed in from the neighbouring byte
+template <int N>
+inline ByteVector ShiftRight(ByteVector a) { return ShiftWordsRight<N>(a) & ByteVector::Set(0xFF >> N); }
+template <int N>
+inline ByteVector ShiftLeft(ByteVector a) { return ShiftWordsLeft<N>(a) & ByteVector::Set(static_cast<uint8_t>(0xFF << N)); }
+
+//0xFF where a byte has an even number of set bits, as the 8080 P flag
+inline ByteVector EvenParity(ByteVector a) {
+	ByteVector folded = a ^ ShiftRight<4>(a);
+	folded = folded ^ ShiftRight<2>(folded);
+	folded = folded ^ ShiftRight<1>(folded);
+	return Equal(folded & ByteVector::Set(1), ByteVector::Set(0));
+}
+
+//index of the lowest set bit, bits is nonzero
+inline size_t LowestBit(uint64_t bits) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, static_cast<unsigned long>(bits))) return index;
+	_BitScanForward(&index, static_cast<unsigned long>(bits >> 32));
+	return index + 32;
+#else
+	return static_cast<size_t>(__builtin_ctzll(bits));
+#endif
+}
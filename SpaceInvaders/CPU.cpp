@@ -1,141 +1,281 @@
 #include "CPU.h"
 
 #include <stdexcept>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
+#include <array>
+#include <utility>
+#include <algorithm>
 
 #include "Disassemble.h"
+#include "Flags.h"
+#include "Jit.h"
+
+#ifdef CPU_FLAG_STATS
+#define COUNT_FLAG_STAT(name) flagStats.name++
+#else
+#define COUNT_FLAG_STAT(name)
+#endif
+
+#ifdef CPU_OPCODE_STATS
+#define COUNT_OPCODE(opcode) CountOpcode(opcode)
+#else
+#define COUNT_OPCODE(opcode)
+#endif
 
 CPU::CPU() {
 	state = {};
-	state.memory.resize(16 * 1024);
+	state.f() = FLAG_ONE;
+	//2 bytes past the end repeat the start of ROM, for operands fetched across the wrap at 0x3FFF
+	state.memory.resize(MIRROR_SIZE + 2);
+	for (uint32_t base = 0; base < 0x10000; base += MIRROR_SIZE) {
+		bus.MapRead(static_cast<uint16_t>(base), MIRROR_SIZE, state.memory.data());
+		bus.DiscardWrites(static_cast<uint16_t>(base), ROM_SIZE);
+		bus.MapWrite(static_cast<uint16_t>(base + ROM_SIZE), RAM_SIZE, state.memory.data() + ROM_SIZE);
+	}
 	shiftRegister = 0;
 }
 
-void CPU::LoadROM(size_t size, void* data) {
-	memcpy(state.memory.data(), data, size);
+CPU::~CPU() {
+}
+
+void CPU::LoadROM(size_t size, const void* data) {
+	memcpy(state.memory.data(), data, std::min<size_t>(size, ROM_SIZE));
+	state.memory[MIRROR_SIZE] = state.memory[0];
+	state.memory[MIRROR_SIZE + 1] = state.memory[1];
+
+	blocks.assign(ROM_SIZE, Block{});
+	decoded.clear();
+#if CPU_JIT_SUPPORTED
+	if (jit) jit->Flush();
+#endif
+#if CPU_RECOMPILED
+	recompiled = recompiled && MatchesRecompiledROM();
+#endif
 }
 
 void CPU::UnrecognizedInstruction() {
 	throw std::runtime_error("Unrecognized instruction");
 }
 
-uint16_t CPU::Combine(uint8_t low, uint8_t high) {
-	uint16_t lo = low;
-	uint16_t hi = high;
-	return (hi << 8) | lo;
+//bit 4 of aux holds the auxiliary carry
+void CPU::SetResultFlags(uint8_t result, uint8_t aux) {
+#if CPU_LAZY_FLAGS
+	state.lazyFlags.result = result;
+	state.lazyFlags.aux = aux;
+	state.lazyFlags.pending = 1;
+#else
+	state.f() = static_cast<uint8_t>((state.f() & FLAG_CY) | FLAG_ONE | resultFlagsTable.entries[result] | (aux & FLAG_AC));
+#endif
+	COUNT_FLAG_STAT(updates);
 }
 
-void CPU::Split(uint16_t value, uint8_t& low, uint8_t& high) {
-	low = static_cast<uint8_t>(value & 0xFF);
-	high = static_cast<uint8_t>((value >> 8) & 0xFF);
+void CPU::MaterializeFlags() {
+#if CPU_LAZY_FLAGS
+	if (state.lazyFlags.pending) {
+		state.f() = static_cast<uint8_t>((state.psw.bytes.low & FLAG_CY) | FLAG_ONE | resultFlagsTable.entries[state.lazyFlags.result] | (state.lazyFlags.aux & FLAG_AC));
+		state.lazyFlags.pending = 0;
+		COUNT_FLAG_STAT(materializations);
+	}
+#endif
 }
 
-uint8_t CPU::CheckParity(uint8_t result) {
-	int p = 0;
-	for (int i = 0; i < 8; i++) {
-		if (result & 1) p++;
-		result >>= 1;
+uint8_t CPU::Zero() {
+#if CPU_LAZY_FLAGS
+	if (state.lazyFlags.pending) {
+		COUNT_FLAG_STAT(materializations);
+		return state.lazyFlags.result == 0;
 	}
-	return !(p & 1);
+#endif
+	return (state.f() >> 6) & 1;
 }
 
-void CPU::SetResultFlags(uint8_t result) {
-	state.conditionCodes.z = result == 0;
-	state.conditionCodes.s = static_cast<int8_t>(result) < 0;
-	state.conditionCodes.p = CheckParity(result);
+uint8_t CPU::Sign() {
+#if CPU_LAZY_FLAGS
+	if (state.lazyFlags.pending) {
+		COUNT_FLAG_STAT(materializations);
+		return state.lazyFlags.result >> 7;
+	}
+#endif
+	return state.f() >> 7;
 }
 
-void CPU::SetCarryFlag(uint16_t result) {
-	state.conditionCodes.cy = result > 255;
+uint8_t CPU::Parity() {
+#if CPU_LAZY_FLAGS
+	if (state.lazyFlags.pending) {
+		COUNT_FLAG_STAT(materializations);
+		return (resultFlagsTable.entries[state.lazyFlags.result] >> 2) & 1;
+	}
+#endif
+	return (state.f() >> 2) & 1;
 }
 
-void CPU::SetCarryFlag(uint32_t result) {
-	state.conditionCodes.cy = result > 65535;
+uint8_t CPU::AuxCarry() {
+#if CPU_LAZY_FLAGS
+	if (state.lazyFlags.pending) {
+		COUNT_FLAG_STAT(materializations);
+		return (state.lazyFlags.aux >> 4) & 1;
+	}
+#endif
+	return (state.f() >> 4) & 1;
 }
 
-void CPU::SetAuxCarryFlag(uint8_t a, uint8_t b) {
-	a &= 0xF;
-	b &= 0xF;
-	state.conditionCodes.ac = (a + b) > 15;
+//CY is never deferred, it always lives in bit 0 of F
+uint8_t CPU::Carry() {
+	return state.f() & FLAG_CY;
 }
 
-uint8_t CPU::Add(uint8_t a, uint8_t b) {
-	uint16_t result = static_cast<uint16_t>(a) + static_cast<uint16_t>(b);
-	SetCarryFlag(result);
-	SetAuxCarryFlag(a, b);
-	SetResultFlags(static_cast<uint8_t>(result));
+void CPU::SetCarry(uint8_t carry) {
+	state.f() = static_cast<uint8_t>((state.f() & ~FLAG_CY) | carry);
+}
+
+uint8_t CPU::AddWithCarry(uint8_t a, uint8_t b, uint8_t carry) {
+	uint16_t result = static_cast<uint16_t>(a) + static_cast<uint16_t>(b) + carry;
+	SetCarry(static_cast<uint8_t>(result >> 8));
+	SetResultFlags(static_cast<uint8_t>(result), static_cast<uint8_t>(a ^ b ^ result));
+
+	return static_cast<uint8_t>(result);
+}
+
+uint8_t CPU::SubtractWithBorrow(uint8_t a, uint8_t b, uint8_t borrow) {
+	uint16_t result = static_cast<uint16_t>(a) - static_cast<uint16_t>(b) - borrow;
+	SetCarry((result >> 8) & 1);
+	//the 8080 subtracts by adding the complement, so AC is the inverted borrow out of bit 3
+	SetResultFlags(static_cast<uint8_t>(result), static_cast<uint8_t>(~(a ^ b ^ result)));
 
 	return static_cast<uint8_t>(result);
 }
 
+uint8_t CPU::Add(uint8_t a, uint8_t b) {
+	return AddWithCarry(a, b, 0);
+}
+
 uint16_t CPU::Add(uint16_t a, uint16_t b) {
 	uint32_t result = static_cast<uint32_t>(a) + static_cast<uint32_t>(b);
-	SetCarryFlag(result);
+	SetCarry(result > 0xFFFF);
 
 	return static_cast<uint16_t>(result);
 }
 
 uint8_t CPU::ADC(uint8_t a, uint8_t b) {
-	uint16_t result = static_cast<uint16_t>(a) + static_cast<uint16_t>(b) + state.conditionCodes.cy;
-	SetCarryFlag(result);
-	SetAuxCarryFlag(a, b);
-	SetResultFlags(static_cast<uint8_t>(result));
+	return AddWithCarry(a, b, Carry());
+}
 
-	return static_cast<uint8_t>(result);
+uint8_t CPU::SUB(uint8_t a, uint8_t b) {
+	return SubtractWithBorrow(a, b, 0);
 }
 
 uint8_t CPU::SBB(uint8_t a, uint8_t b) {
-	uint16_t result = static_cast<uint16_t>(a) - static_cast<uint16_t>(b) - state.conditionCodes.cy;
-	SetCarryFlag(result);
-	SetAuxCarryFlag(a, -b);
-	SetResultFlags(static_cast<uint8_t>(result));
+	return SubtractWithBorrow(a, b, Carry());
+}
 
-	return static_cast<uint8_t>(result);
+uint8_t CPU::INR(uint8_t value) {
+	const IncDecResult& entry = incrementTable.entries[value];
+	SetResultFlags(entry.result, entry.aux);
+
+	return entry.result;
+}
+
+uint8_t CPU::DCR(uint8_t value) {
+	const IncDecResult& entry = decrementTable.entries[value];
+	SetResultFlags(entry.result, entry.aux);
+
+	return entry.result;
 }
 
 uint8_t CPU::ANA(uint8_t a, uint8_t b) {
 	uint8_t result = a & b;
-	state.conditionCodes.cy = 0;
-	SetResultFlags(result);
+	SetCarry(0);
+	SetResultFlags(result, static_cast<uint8_t>((a | b) << 1));
 
-	return static_cast<uint8_t>(result);
+	return result;
 }
 
 uint8_t CPU::XRA(uint8_t a, uint8_t b) {
 	uint8_t result = a ^ b;
-	state.conditionCodes.cy = 0;
-	state.conditionCodes.ac = 0;
-	SetResultFlags(result);
+	SetCarry(0);
+	SetResultFlags(result, 0);
 
-	return static_cast<uint8_t>(result);
+	return result;
 }
 
 uint8_t CPU::ORA(uint8_t a, uint8_t b) {
 	uint8_t result = a | b;
-	state.conditionCodes.cy = 0;
-	SetResultFlags(result);
+	SetCarry(0);
+	SetResultFlags(result, 0);
 
-	return static_cast<uint8_t>(result);
+	return result;
 }
 
 void CPU::CMP(uint8_t a, uint8_t b) {
-	uint16_t result = static_cast<uint16_t>(a) - static_cast<uint16_t>(b);
-	SetCarryFlag(result);
-	SetResultFlags(static_cast<uint8_t>(result));
+	SubtractWithBorrow(a, b, 0);
 }
 
-void CPU::Push(uint16_t value) {
-	Split(value, state.memory[state.sp - 2], state.memory[state.sp - 1]);
+FORCE_INLINE void CPU::Push(uint16_t value) {
 	state.sp -= 2;
+	bus.WriteWord(state.sp, value);
 }
 
-uint16_t CPU::Pop() {
-	uint16_t result = Combine(state.memory[state.sp], state.memory[state.sp + 1]);
+FORCE_INLINE uint16_t CPU::Pop() {
+	uint16_t result = bus.ReadWord(state.sp);
 	state.sp += 2;
 	return result;
 }
 
+const State& CPU::GetState() {
+	MaterializeFlags();
+	return state;
+}
+
+void CPU::SaveState(Snapshot& snapshot) const {
+	snapshot.bc = state.bc;
+	snapshot.de = state.de;
+	snapshot.hl = state.hl;
+	snapshot.psw = state.psw;
+	snapshot.sp = state.sp;
+	snapshot.pc = state.pc;
+	//F is saved materialized, so a machine saves to the same bytes whichever engine ran it
+	snapshot.lazyFlags = {};
+#if CPU_LAZY_FLAGS
+	if (state.lazyFlags.pending) {
+		snapshot.psw.bytes.low = static_cast<uint8_t>((state.psw.bytes.low & FLAG_CY) | FLAG_ONE | resultFlagsTable.entries[state.lazyFlags.result] | (state.lazyFlags.aux & FLAG_AC));
+	}
+#endif
+	snapshot.interruptEnable = state.interruptEnable;
+	snapshot.nextInterruptValue = nextInterruptValue;
+	memcpy(snapshot.inputs, inputs, sizeof(inputs));
+	memcpy(snapshot.outputs, outputs, sizeof(outputs));
+	snapshot.shiftRegister = shiftRegister;
+	snapshot.instructionCount = instructionCount;
+	snapshot.cycleCount = cycleCount;
+	snapshot.cycleLimit = cycleLimit;
+	snapshot.nextInterruptCycle = nextInterruptCycle;
+	memcpy(snapshot.ram, &state.memory[ROM_SIZE], RAM_SIZE);
+}
+
+//the block caches and JIT only hold ROM code, so they stay valid
+//RAM is copied past the bus, so a Display has to be told with Invalidate
+void CPU::LoadState(const Snapshot& snapshot) {
+	state.bc = snapshot.bc;
+	state.de = snapshot.de;
+	state.hl = snapshot.hl;
+	state.psw = snapshot.psw;
+	state.sp = snapshot.sp;
+	state.pc = snapshot.pc;
+	state.lazyFlags = snapshot.lazyFlags;
+	state.interruptEnable = snapshot.interruptEnable;
+	nextInterruptValue = snapshot.nextInterruptValue;
+	memcpy(inputs, snapshot.inputs, sizeof(inputs));
+	memcpy(outputs, snapshot.outputs, sizeof(outputs));
+	shiftRegister = snapshot.shiftRegister;
+	instructionCount = snapshot.instructionCount;
+	cycleCount = snapshot.cycleCount;
+	cycleLimit = snapshot.cycleLimit;
+	nextInterruptCycle = snapshot.nextInterruptCycle;
+	memcpy(&state.memory[ROM_SIZE], snapshot.ram, RAM_SIZE);
+}
+
 void CPU::SetInput(size_t index, uint8_t value) {
 	inputs[index] = value;
 }
@@ -165,9 +305,16 @@ void CPU::Interrupt(size_t value) {
 	state.pc = static_cast<uint16_t>(value * 8);
 }
 
-void CPU::QueueInterrupt(size_t value, size_t instructionDelay) {
-	if (state.interruptEnable) {
-		queue.push(CPU::Interrupt_t{ value, instructionCount + instructionDelay });
+//the video hardware raises RST 1 when the beam reaches mid-screen and RST 2 at VBlank
+void CPU::CheckInterrupt() {
+	if (cycleCount >= nextInterruptCycle) {
+		if (state.interruptEnable) {
+			state.interruptEnable = 0;
+			Interrupt(nextInterruptValue);
+			cycleCount += INTERRUPT_CYCLES;
+		}
+		nextInterruptValue = nextInterruptValue == 1 ? 2 : 1;
+		nextInterruptCycle += HALF_FRAME_CYCLES;
 	}
 }
 
@@ -175,1062 +322,594 @@ void CPU::AddFrame() {
 	frameCount.fetch_add(1, std::memory_order_relaxed);
 }
 
+uint64_t CPU::RunFrame() {
+	cycleLimit += FRAME_CYCLES;
+	return Run(FRAME_CYCLES);
+}
+
+//translated INR and DCR leave a lazy result behind, so the JIT needs CPU_LAZY_FLAGS
+bool CPU::EnableJit(bool enable) {
+#if CPU_JIT_SUPPORTED && CPU_LAZY_FLAGS
+	if (enable && !jit) {
+		jit.reset(new Jit(*this));
+	} else if (!enable) {
+		jit.reset();
+	}
+#else
+	(void)enable;
+#endif
+	return jit != nullptr;
+}
+
+//recompiled code only exists for the ROM it was generated from, so enable it after LoadROM
+bool CPU::EnableRecompiled(bool enable) {
+#if CPU_RECOMPILED
+	recompiled = enable && MatchesRecompiledROM();
+#else
+	(void)enable;
+#endif
+	return recompiled;
+}
+
+//pays the interrupt check and the dispatch entry for every instruction, hot loops go through Run
 void CPU::Step() {
-	uint32_t count = frameCount.exchange(0, std::memory_order_relaxed);
+	CheckInterrupt();
+	Dispatch(cycleCount + 1);
+}
 
-	for (uint32_t i = 0; i < count * 2; i++) {
-		QueueInterrupt(2, i * 5000);
+//blocks are indexed by their start address and decoded the first time they run
+const CPU::Block& CPU::GetBlock(uint16_t pc) {
+	Block& block = blocks[pc];
+	if (block.count == 0) {
+		DecodeBlock(pc, block);
 	}
+	return block;
+}
 
-	if (!queue.empty()) {
-		auto interrupt = queue.front();
-		if (instructionCount >= interrupt.target) {
-			queue.pop();
-			Interrupt(interrupt.value);
-		}
+void CPU::DecodeBlock(uint16_t pc, Block& block) {
+	block.first = static_cast<uint32_t>(decoded.size());
+
+	while (pc < ROM_SIZE && block.count < MAX_BLOCK_LENGTH) {
+		uint8_t opcode = bus.Read(pc);
+		uint8_t length = lengthTable.entries[opcode];
+		if (pc + length > ROM_SIZE) break;
+
+		DecodedInstruction inst = {};
+		inst.opcode = opcode;
+		inst.cycles = cycleTable.entries[opcode];
+		if (length > 1) inst.operand = bus.Read(pc + 1);
+		if (length > 2) inst.operand |= bus.Read(pc + 2) << 8;
+
+		decoded.push_back(inst);
+		block.count++;
+		block.cycles += inst.cycles;
+		pc += length;
+
+		if (opcodeTable.entries[opcode].endsBlock) break;
+	}
+}
+
+//cross-thread signals are only checked here, once per batch, instead of before every instruction
+uint64_t CPU::Run(uint64_t budget) {
+	cycleLimit += static_cast<uint64_t>(frameCount.exchange(0, std::memory_order_relaxed)) * FRAME_CYCLES;
+
+	uint64_t start = cycleCount;
+	uint64_t end = std::min(cycleCount + budget, cycleLimit);
+
+	while (cycleCount < end) {
+		CheckInterrupt();
+		uint64_t target = std::min(end, nextInterruptCycle);
+#if CPU_RECOMPILED
+		if (recompiled) {
+			RunRecompiled(target);
+			//pc left the recompiled code, or its next block would run past target
+			if (cycleCount < target) {
+				Dispatch(cycleCount + 1);
+			}
+			continue;
+		}
+#endif
+#if CPU_JIT_SUPPORTED
+		if (jit) {
+			jit->Run(target);
+			continue;
+		}
+#endif
+#if CPU_BLOCK_CACHE
+		RunBlocks(target);
+#else
+		Dispatch(target);
+#endif
 	}
 
-	uint8_t* inst = &state.memory[state.pc];
+	return cycleCount - start;
+}
+
+//code only runs from ROM and RAM, so opcodes are read from the block the bus mirrors rather than through the page table
+//the extra dependent load on every fetch cost the interpreter about 15%
+FORCE_INLINE const uint8_t* CPU::CodeAt(uint16_t address) const {
+	return state.memory.data() + (address & (MIRROR_SIZE - 1));
+}
+
+FORCE_INLINE const uint8_t* CPU::Fetch() {
+	const uint8_t* inst = CodeAt(state.pc);
 	state.pc++;
 	instructionCount++;
+	cycleCount += cycleTable.entries[inst[0]];
+	COUNT_OPCODE(inst[0]);
+	return inst;
+}
 
-	switch (*inst) {
-		default:
-			std::cout << std::hex << std::setw(4) << state.pc << " ";
-			Disassemble(inst);
-			std::cout << "\n";
-			UnrecognizedInstruction();
-			break;
-		case 0x00:	//NOP
-		case 0x08:
-		case 0x20:
-			break;
-		case 0x01:	//LXI B, word
-			state.c = inst[1];
-			state.b = inst[2];
-			state.pc += 2;
-			break;
-		case 0x02:	//STAX A
-			state.memory[Combine(state.c, state.b)] = state.a;
-			break;
-		case 0x03:	//INX B
-		{
-			uint16_t temp = Combine(state.c, state.b) + 1;
-			Split(temp, state.c, state.b);
-			break;
-		}
-		case 0x04:	//INR B
-			state.b = Add(state.b, 1);
-			break;
-		case 0x05:	//DCR B
-			state.b = Add(state.b, -1);
-			break;
-		case 0x06:	//MVI B, byte
-			state.b = inst[1];
-			state.pc += 1;
-			break;
-		case 0x07:	//RLC
-			state.conditionCodes.cy = (state.a >> 7);
-			state.a = (state.a << 1) | (state.a >> 7);
-			break;
-		case 0x09:	//DAD B
-		{
-			uint16_t temp = Add(Combine(state.l, state.h), Combine(state.c, state.b));
-			Split(temp, state.l, state.h);
-			break;
-		}
-		case 0x0A:	//LDAX B
-			state.a = state.memory[Combine(state.c, state.b)];
-			break;
-		case 0x0B:	//DCX B
-		{
-			uint16_t temp = Combine(state.c, state.b) - 1;
-			Split(temp, state.c, state.b);
-			break;
-		}
-		case 0x0C:	//INR C
-			state.c = Add(state.c, 1);
-			break;
-		case 0x0D:	//DCR C
-			state.c = Add(state.c, -1);
-			break;
-		case 0x0E:	//MVI C, byte
-			state.c = inst[1];
-			state.pc += 1;
-			break;
-		case 0x0F:	//RRC
-			state.conditionCodes.cy = (state.a & 1);
-			state.a = (state.a >> 1) | (state.a << 7);
-			break;
-		case 0x11:	//LXI D, word
-			state.e = inst[1];
-			state.d = inst[2];
-			state.pc += 2;
-			break;
-		case 0x12:	//STAX D
-			state.memory[Combine(state.e, state.d)] = state.a;
-			break;
-		case 0x13:	//INX D
-		{
-			uint16_t temp = Combine(state.e, state.d) + 1;
-			Split(temp, state.e, state.d);
-			break;
-		}
-		case 0x14:	//INR D
-			state.d = Add(state.d, 1);
-			break;
-		case 0x15:	//DCR D
-			state.d = Add(state.d, -1);
-			break;
-		case 0x16:	//MVI D, byte
-			state.d = inst[1];
-			state.pc += 1;
-			break;
-		case 0x17:	//RAL
-		{
-			uint8_t temp = state.conditionCodes.cy & 1;
-			state.conditionCodes.cy = (state.a >> 7);
-			state.a = (state.a << 1) | temp;
-			break;
-		}
-		case 0x19:	//DAD D
-		{
-			uint16_t temp = Add(Combine(state.l, state.h), Combine(state.e, state.d));
-			Split(temp, state.l, state.h);
-			break;
-		}
-		case 0x1A:	//LDAX D
-			state.a = state.memory[Combine(state.e, state.d)];
-			break;
-		case 0x1B:	//DCX D
-		{
-			uint16_t temp = Combine(state.e, state.d) - 1;
-			Split(temp, state.e, state.d);
-			break;
-		}
-		case 0x1C:	//INR E
-			state.e = Add(state.e, 1);
-			break;
-		case 0x1D:	//DCR E
-			state.e = Add(state.e, -1);
-			break;
-		case 0x1E:	//MVI E, byte
-			state.e = inst[1];
-			state.pc += 1;
-			break;
-		case 0x1F:	//RAR
-		{
-			uint8_t temp = state.conditionCodes.cy & 1;
-			state.conditionCodes.cy = state.a & 1;
-			state.a = (state.a >> 1) | (temp << 7);
-			break;
-		}
-		case 0x21:	//LXI H, word
-			state.l = inst[1];
-			state.h = inst[2];
-			state.pc += 2;
-			break;
-		case 0x22:	//SHLD addr
-		{
-			uint16_t addr = Combine(inst[1], inst[2]);
-			state.memory[addr] = state.l;
-			state.memory[addr + 1] = state.h;
-			state.pc += 2;
-			break;
-		}
-		case 0x23:	//INX H
-		{
-			uint16_t temp = Combine(state.l, state.h) + 1;
-			Split(temp, state.l, state.h);
-			break;
-		}
-		case 0x24:	//INR H
-			state.h = Add(state.h, 1);
-			break;
-		case 0x25:	//DCR H
-			state.h = Add(state.h, -1);
-			break;
-		case 0x26:	//MVI H, byte
-			state.h = inst[1];
-			state.pc += 1;
-			break;
-		case 0x29:	//DAD H
-		{
-			uint32_t temp = Add(Combine(state.l, state.h), Combine(state.l, state.h));
-			Split(temp, state.l, state.h);
-			break;
-		}
-		case 0x2A:	//LHLD addr
-		{
-			uint16_t addr = Combine(inst[1], inst[2]);
-			state.l = state.memory[addr];
-			state.h = state.memory[addr + 1];
-			state.pc += 2;
-			break;
-		}
-		case 0x2B:	//DCX H
-		{
-			uint16_t temp = Combine(state.l, state.h) - 1;
-			Split(temp, state.l, state.h);
-			break;
-		}
-		case 0x2C:	//INR L
-			state.l = Add(state.l, 1);
-			break;
-		case 0x2D:	//DCR L
-			state.l = Add(state.l, -1);
-			break;
-		case 0x2E:	//MVI L, byte
-			state.l = inst[1];
-			state.pc += 1;
-			break;
-		case 0x2F:	//CMA
-			state.a = ~state.a;
-			break;
-		case 0x31:	//LXI SP, word
-			state.sp = Combine(inst[1], inst[2]);
-			state.pc += 2;
-			break;
-		case 0x32: //STA addr
-		{
-			uint16_t addr = Combine(inst[1], inst[2]);
-			state.memory[addr] = state.a;
-			state.pc += 2;
-			break;
-		}
-		case 0x33:	//INX SP
-			state.sp++;
-			break;
-		case 0x34:	//INR M
-		{
-			uint8_t& temp = state.memory[Combine(state.l, state.h)];
-			temp = Add(temp, 1);
-			break;
-		}
-		case 0x35:	//DCR M
-		{
-			uint8_t& temp = state.memory[Combine(state.l, state.h)];
-			temp = Add(temp, -1);
-			break;
-		}
-		case 0x36:	//MVI M, byte
-		{
-			uint8_t& temp = state.memory[Combine(state.l, state.h)];
-			temp = inst[1];
-			state.pc += 1;
-			break;
-		}
-		case 0x37: //STC
-			state.conditionCodes.cy = 1;
-			break;
-		case 0x39:	//DAD SP
-		{
-			uint32_t temp = Add(Combine(state.l, state.h), state.sp);
-			Split(temp, state.l, state.h);
-			break;
-		}
-		case 0x3A:	//LDA addr
-		{
-			uint16_t addr = Combine(inst[1], inst[2]);
-			state.a = state.memory[addr];
-			state.pc += 2;
-			break;
-		}
-		case 0x3B:	//DCR SP
-			state.sp--;
-			break;
-		case 0x3C:	//INR A
-			state.a = Add(state.a, 1);
-			break;
-		case 0x3D:	//DCR A
-			state.a = Add(state.a, -1);
-			break;
-		case 0x3E:	//MVI A, byte
-			state.a = inst[1];
-			state.pc += 1;
-			break;
-		case 0x3F:	//CMC
-			state.conditionCodes.cy = !state.conditionCodes.cy;
-			break;
-		case 0x40:	//MOV B, B
-			break;
-		case 0x41:	//MOV B, C
-			state.b = state.c;
-			break;
-		case 0x42:	//MOV B, D
-			state.b = state.d;
-			break;
-		case 0x43:	//MOV B, E
-			state.b = state.e;
-			break;
-		case 0x44:	//MOV B, H
-			state.b = state.h;
-			break;
-		case 0x45:	//MOV B, L
-			state.b = state.l;
-			break;
-		case 0x46:	//MOV B, M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.b = state.memory[addr];
-			break;
-		}
-		case 0x47:	//MOV B, A
-			state.b = state.a;
-			break;
-		case 0x48:	//MOV C, B
-			state.c = state.b;
-			break;
-		case 0x49:	//MOV C, C
-			break;
-		case 0x4A:	//MOV C, D
-			state.c = state.d;
-			break;
-		case 0x4B:	//MOV C, E
-			state.c = state.e;
-			break;
-		case 0x4C:	//MOV C, H
-			state.c = state.h;
-			break;
-		case 0x4D:	//MOV C, L
-			state.c = state.l;
-			break;
-		case 0x4E:	//MOV C, M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.c = state.memory[addr];
-			break;
-		}
-		case 0x4F:	//MOV C, A
-			state.c = state.a;
-			break;
-		case 0x50:	//MOV D, B
-			state.d = state.b;
-			break;
-		case 0x51:	//MOV D, C
-			state.d = state.c;
-			break;
-		case 0x52:	//MOV D, D
-			break;
-		case 0x53:	//MOV D, E
-			state.d = state.e;
-			break;
-		case 0x54:	//MOV D, H
-			state.d = state.h;
-			break;
-		case 0x55:	//MOV D, L
-			state.d = state.l;
-			break;
-		case 0x56:	//MOV D, M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.d = state.memory[addr];
-			break;
-		}
-		case 0x57:	//MOV D, A
-			state.d = state.a;
-			break;
-		case 0x58:	//MOV E, B
-			state.e = state.b;
-			break;
-		case 0x59:	//MOV E, C
-			state.e = state.c;
-			break;
-		case 0x5A:	//MOV E, D
-			state.e = state.d;
-			break;
-		case 0x5B:	//MOV E, E
-			break;
-		case 0x5C:	//MOV E, H
-			state.e = state.h;
-			break;
-		case 0x5D:	//MOV E, L
-			state.e = state.l;
-			break;
-		case 0x5E:	//MOV E, M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.e = state.memory[addr];
-			break;
-		}
-		case 0x5F:	//MOV E, A
-			state.e = state.a;
-			break;
-		case 0x60:	//MOV H, B
-			state.h = state.b;
-			break;
-		case 0x61:	//MOV H, C
-			state.h = state.c;
-			break;
-		case 0x62:	//MOV H, D
-			state.h = state.d;
-			break;
-		case 0x63:	//MOV H, E
-			state.h = state.e;
-			break;
-		case 0x64:	//MOV H, H
-			break;
-		case 0x65:	//MOV H, L
-			state.h = state.l;
-			break;
-		case 0x66:	//MOV H, M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.h = state.memory[addr];
-			break;
-		}
-		case 0x67:	//MOV H, A
-			state.h = state.a;
-			break;
-		case 0x68:	//MOV L, B
-			state.l = state.b;
-			break;
-		case 0x69:	//MOV L, C
-			state.l = state.c;
-			break;
-		case 0x6A:	//MOV L, D
-			state.l = state.d;
-			break;
-		case 0x6B:	//MOV L, E
-			state.l = state.e;
-			break;
-		case 0x6C:	//MOV L, H
-			state.l = state.h;
-			break;
-		case 0x6D:	//MOV L, L
-			break;
-		case 0x6E:	//MOV L, M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.l = state.memory[addr];
-			break;
-		}
-		case 0x6F:	//MOV L, A
-			state.l = state.a;
-			break;
-		case 0x70:	//MOV M, B
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.memory[addr] = state.b;
-			break;
-		}
-		case 0x71:	//MOV M, C
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.memory[addr] = state.c;
-			break;
-		}
-		case 0x72:	//MOV M, D
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.memory[addr] = state.d;
-			break;
-		}
-		case 0x73:	//MOV M, E
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.memory[addr] = state.e;
-			break;
-		}
-		case 0x74:	//MOV M, H
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.memory[addr] = state.h;
-			break;
-		}
-		case 0x75:	//MOV M, L
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.memory[addr] = state.l;
-			break;
-		}
-		//0x76 HLT
-		case 0x77:	//MOV M, A
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.memory[addr] = state.a;
-			break;
-		}
-		case 0x78:	//MOV A, B
-			state.a = state.b;
-			break;
-		case 0x79:	//MOV A, C
-			state.a = state.c;
-			break;
-		case 0x7A:	//MOV A, D
-			state.a = state.d;
-			break;
-		case 0x7B:	//MOV A, E
-			state.a = state.e;
-			break;
-		case 0x7C:	//MOV A, H
-			state.a = state.h;
-			break;
-		case 0x7D:	//MOV A, L
-			state.a = state.l;
-			break;
-		case 0x7E:	//MOV A, M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			state.a = state.memory[addr];
-			break;
-		}
-		case 0x7F:	//MOV A, A
-			break;
-		case 0x80:	//ADD B
-			state.a = Add(state.a, state.b);
-			break;
-		case 0x81:	//ADD C
-			state.a = Add(state.a, state.c);
-			break;
-		case 0x82:	//ADD D
-			state.a = Add(state.a, state.d);
-			break;
-		case 0x83:	//ADD E
-			state.a = Add(state.a, state.e);
-			break;
-		case 0x84:	//ADD H
-			state.a = Add(state.a, state.h);
-			break;
-		case 0x85:	//ADD L
-			state.a = Add(state.a, state.l);
-			break;
-		case 0x86:	//ADD M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			uint8_t value = state.memory[addr];
-			state.a = Add(state.a, value);
-			break;
-		}
-		case 0x87:	//ADD A
-			state.a = Add(state.a, state.a);
-			break;
-		case 0x88:	//ADC B
-			state.a = ADC(state.a, state.b);
-			break;
-		case 0x89:	//ADC C
-			state.a = ADC(state.a, state.c);
-			break;
-		case 0x8A:	//ADC D
-			state.a = ADC(state.a, state.d);
-			break;
-		case 0x8B:	//ADC E
-			state.a = ADC(state.a, state.e);
-			break;
-		case 0x8C:	//ADC H
-			state.a = ADC(state.a, state.h);
-			break;
-		case 0x8D:	//ADC L
-			state.a = ADC(state.a, state.l);
-			break;
-		case 0x8E:	//ADC M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			uint8_t value = state.memory[addr];
-			state.a = ADC(state.a, value);
-			break;
-		}
-		case 0x8F:	//ADC A
-			state.a = ADC(state.a, state.a);
-			break;
-		case 0x90:	//SUB B
-			state.a = Add(state.a, -state.b);
-			break;
-		case 0x91:	//SUB C
-			state.a = Add(state.a, -state.c);
-			break;
-		case 0x92:	//SUB D
-			state.a = Add(state.a, -state.d);
-			break;
-		case 0x93:	//SUB E
-			state.a = Add(state.a, -state.e);
-			break;
-		case 0x94:	//SUB H
-			state.a = Add(state.a, -state.h);
-			break;
-		case 0x95:	//SUB L
-			state.a = Add(state.a, -state.l);
-			break;
-		case 0x96:	//SUB M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			uint8_t value = state.memory[addr];
-			uint8_t temp = state.a - value;
-			state.a = Add(state.a, -value);
-			break;
-		}
-		case 0x97:	//SUB A
-			state.a = Add(state.a, -state.a);
-			break;
-		case 0x98:	//SBB B
-			state.a = SBB(state.a, state.b);
-			break;
-		case 0x99:	//SBB C
-			state.a = SBB(state.a, state.c);
-			break;
-		case 0x9A:	//SBB D
-			state.a = SBB(state.a, state.d);
-			break;
-		case 0x9B:	//SBB E
-			state.a = SBB(state.a, state.e);
-			break;
-		case 0x9C:	//SBB H
-			state.a = SBB(state.a, state.h);
-			break;
-		case 0x9D:	//SBB L
-			state.a = SBB(state.a, state.l);
-			break;
-		case 0x9E:	//SBB M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			uint8_t value = state.memory[addr];
-			state.a = SBB(state.a, value);
-			break;
-		}
-		case 0x9F:	//SBB A
-			state.a = SBB(state.a, state.a);
-			break;
-		case 0xA0:	//ANA B
-			state.a = ANA(state.a, state.b);
-			break;
-		case 0xA1:	//ANA C
-			state.a = ANA(state.a, state.c);
-			break;
-		case 0xA2:	//ANA D
-			state.a = ANA(state.a, state.d);
-			break;
-		case 0xA3:	//ANA E
-			state.a = ANA(state.a, state.e);
-			break;
-		case 0xA4:	//ANA H
-			state.a = ANA(state.a, state.h);
-			break;
-		case 0xA5:	//ANA L
-			state.a = ANA(state.a, state.l);
-			break;
-		case 0xA6:	//ANA M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			uint8_t value = state.memory[addr];
-			state.a = ANA(state.a, value);
-			break;
-		}
-		case 0xA7:	//ANA A
-			state.a = ANA(state.a, state.a);
-			break;
-		case 0xA8:	//XRA B
-			state.a = XRA(state.a, state.b);
-			break;
-		case 0xA9:	//XRA C
-			state.a = XRA(state.a, state.c);
-			break;
-		case 0xAA:	//XRA D
-			state.a = XRA(state.a, state.d);
-			break;
-		case 0xAB:	//XRA E
-			state.a = XRA(state.a, state.e);
-			break;
-		case 0xAC:	//XRA H
-			state.a = XRA(state.a, state.h);
-			break;
-		case 0xAD:	//XRA L
-			state.a = XRA(state.a, state.l);
-			break;
-		case 0xAE:	//XRA M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			uint8_t value = state.memory[addr];
-			state.a = XRA(state.a, value);
-			break;
-		}
-		case 0xAF:	//XRA A
-			state.a = XRA(state.a, state.a);
-			break;
-		case 0xB0:	//ORA B
-			state.a = ORA(state.a, state.b);
-			break;
-		case 0xB1:	//ORA C
-			state.a = ORA(state.a, state.c);
-			break;
-		case 0xB2:	//ORA D
-			state.a = ORA(state.a, state.d);
-			break;
-		case 0xB3:	//ORA E
-			state.a = ORA(state.a, state.e);
-			break;
-		case 0xB4:	//ORA H
-			state.a = ORA(state.a, state.h);
-			break;
-		case 0xB5:	//ORA L
-			state.a = ORA(state.a, state.l);
-			break;
-		case 0xB6:	//ORA M
-		{
-			uint16_t addr = Combine(state.l, state.h);
-			uint8_t value = state.memory[addr];
-			state.a = ORA(state.a, value);
-			break;
-		}
-		case 0xB7:	//ORA A
-			state.a = ORA(state.a, state.a);
-			break;
-		case 0xC0:	//RNZ
-			if (!state.conditionCodes.z) {
-				state.pc = Pop();
-			}
-			break;
-		case 0xC1:	//POP B
-			Split(Pop(), state.c, state.b);
-			break;
-		case 0xC2:	//JNZ addr
-			if (state.conditionCodes.z == 0) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xC3:	//JMP addr
-		{
-			state.pc = Combine(inst[1], inst[2]);
-			break;
-		}
-		case 0xC4:	//CNZ
-			if (!state.conditionCodes.z) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xC5:	//PUSH B
-			Push(Combine(state.c, state.b));
-			break;
-		case 0xC6:	//ADI byte
-		{
-			uint16_t temp = static_cast<uint16_t>(state.a) + static_cast<uint16_t>(inst[1]);
-			SetResultFlags(static_cast<uint8_t>(temp));
-			SetCarryFlag(temp);
-			state.a = static_cast<uint8_t>(temp);
-			state.pc += 1;
-			break;
-		}
-		case 0xC7:	//RST 0
-		{
-			Interrupt(0);
-			break;
-		}
-		case 0xC8:	//RZ
-			if (state.conditionCodes.z) {
-				state.pc = Pop();
-			}
-			break;
-		case 0xC9:	//RET
-		{
+#ifdef CPU_OPCODE_STATS
+void CPU::CountOpcode(uint8_t opcode) {
+	opcodeStats.history = ((opcodeStats.history << 8) | opcode) & 0xFFFFFF;
+	opcodeStats.seen++;
+	if (opcodeStats.seen >= 2) opcodeStats.pairs[opcodeStats.history & 0xFFFF]++;
+	if (opcodeStats.seen >= 3) opcodeStats.triples[opcodeStats.history]++;
+}
+#endif
+
+#define OPCODES_ROW(X, h) \
+	X(h##0) X(h##1) X(h##2) X(h##3) X(h##4) X(h##5) X(h##6) X(h##7) \
+	X(h##8) X(h##9) X(h##A) X(h##B) X(h##C) X(h##D) X(h##E) X(h##F)
+
+#define OPCODES(X) \
+	OPCODES_ROW(X, 0) OPCODES_ROW(X, 1) OPCODES_ROW(X, 2) OPCODES_ROW(X, 3) \
+	OPCODES_ROW(X, 4) OPCODES_ROW(X, 5) OPCODES_ROW(X, 6) OPCODES_ROW(X, 7) \
+	OPCODES_ROW(X, 8) OPCODES_ROW(X, 9) OPCODES_ROW(X, A) OPCODES_ROW(X, B) \
+	OPCODES_ROW(X, C) OPCODES_ROW(X, D) OPCODES_ROW(X, E) OPCODES_ROW(X, F)
+
+//registers in opcode order B, C, D, E, H, L, M, A, where M is the byte at HL
+template <uint8_t R>
+FORCE_INLINE uint8_t CPU::GetRegister() {
+	switch (R) {
+		case 0: return state.b();
+		case 1: return state.c();
+		case 2: return state.d();
+		case 3: return state.e();
+		case 4: return state.h();
+		case 5: return state.l();
+		case 6: return bus.Read(state.hl.word);
+		default: return state.a();
+	}
+}
+
+template <uint8_t R>
+FORCE_INLINE void CPU::SetRegister(uint8_t value) {
+	switch (R) {
+		case 0: state.b() = value; break;
+		case 1: state.c() = value; break;
+		case 2: state.d() = value; break;
+		case 3: state.e() = value; break;
+		case 4: state.h() = value; break;
+		case 5: state.l() = value; break;
+		case 6: bus.Write(state.hl.word, value); break;
+		default: state.a() = value; break;
+	}
+}
+
+//pairs in opcode order BC, DE, HL, SP; PUSH and POP use PSW in place of SP
+template <uint8_t P>
+FORCE_INLINE uint16_t& CPU::Pair() {
+	switch (P) {
+		case 0: return state.bc.word;
+		case 1: return state.de.word;
+		case 2: return state.hl.word;
+		default: return state.sp;
+	}
+}
+
+//conditions in opcode order NZ, Z, NC, C, PO, PE, P, M
+template <uint8_t C>
+FORCE_INLINE bool CPU::Condition() {
+	uint8_t flag;
+	switch (C >> 1) {
+		case 0: flag = Zero(); break;
+		case 1: flag = Carry(); break;
+		case 2: flag = Parity(); break;
+		default: flag = Sign(); break;
+	}
+	return (C & 1) ? flag != 0 : flag == 0;
+}
+
+//operations in opcode order ADD, ADC, SUB, SBB, ANA, XRA, ORA, CMP
+template <uint8_t O>
+FORCE_INLINE void CPU::Arithmetic(uint8_t value) {
+	switch (O) {
+		case 0: state.a() = Add(state.a(), value); break;
+		case 1: state.a() = ADC(state.a(), value); break;
+		case 2: state.a() = SUB(state.a(), value); break;
+		case 3: state.a() = SBB(state.a(), value); break;
+		case 4: state.a() = ANA(state.a(), value); break;
+		case 5: state.a() = XRA(state.a(), value); break;
+		case 6: state.a() = ORA(state.a(), value); break;
+		default: CMP(state.a(), value); break;
+	}
+}
+
+//an opcode splits into xx yyy zzz, and the regular families are one template each, specialized on the fields
+//with Op known, every branch below folds away and leaves only that opcode's code
+template <uint8_t Op, typename Operands>
+FORCE_INLINE void CPU::Execute(Operands operands) {
+	constexpr uint8_t y = (Op >> 3) & 7;
+	constexpr uint8_t z = Op & 7;
+	constexpr uint8_t p = (Op >> 4) & 3;
+	//Fetch stepped over the opcode, the operands after it are counted by the shared length table
+	constexpr uint8_t operandBytes = lengthTable.entries[Op] - 1;
+
+	if ((Op & 0xC0) == 0x40 && Op != 0x76) {	//MOV r, r
+		SetRegister<y>(GetRegister<z>());
+	} else if ((Op & 0xC0) == 0x80) {	//ADD r through CMP r
+		Arithmetic<y>(GetRegister<z>());
+	} else if ((Op & 0xC7) == 0xC6) {	//ADI byte through CPI byte
+		Arithmetic<y>(operands.Byte());
+		state.pc += operandBytes;
+	} else if ((Op & 0xC7) == 0x04) {	//INR r
+		SetRegister<y>(INR(GetRegister<y>()));
+	} else if ((Op & 0xC7) == 0x05) {	//DCR r
+		SetRegister<y>(DCR(GetRegister<y>()));
+	} else if ((Op & 0xC7) == 0x06) {	//MVI r, byte
+		SetRegister<y>(operands.Byte());
+		state.pc += operandBytes;
+	} else if ((Op & 0xCF) == 0x01) {	//LXI rp, word
+		Pair<p>() = operands.Word();
+		state.pc += operandBytes;
+	} else if ((Op & 0xCF) == 0x03) {	//INX rp
+		Pair<p>()++;
+	} else if ((Op & 0xCF) == 0x0B) {	//DCX rp
+		Pair<p>()--;
+	} else if ((Op & 0xCF) == 0x09) {	//DAD rp
+		state.hl.word = Add(state.hl.word, Pair<p>());
+	} else if ((Op & 0xCF) == 0xC5) {	//PUSH rp
+		if (p == 3) {
+			MaterializeFlags();
+			Push(state.psw.word);
+		} else {
+			Push(Pair<p>());
+		}
+	} else if ((Op & 0xCF) == 0xC1) {	//POP rp
+		if (p == 3) {
+			state.psw.word = Pop();
+			state.f() = (state.f() & FLAG_MASK) | FLAG_ONE;
+			state.lazyFlags.pending = 0;
+		} else {
+			Pair<p>() = Pop();
+		}
+	} else if ((Op & 0xC7) == 0xC2) {	//Jcc addr
+		if (Condition<y>()) {
+			state.pc = operands.Word();
+		} else {
+			state.pc += operandBytes;
+		}
+	} else if ((Op & 0xC7) == 0xC4) {	//Ccc addr
+		if (Condition<y>()) {
+			cycleCount += opcodeTable.entries[Op].takenCycles;
+			Push(state.pc + operandBytes);
+			state.pc = operands.Word();
+		} else {
+			state.pc += operandBytes;
+		}
+	} else if ((Op & 0xC7) == 0xC0) {	//Rcc
+		if (Condition<y>()) {
+			cycleCount += opcodeTable.entries[Op].takenCycles;
 			state.pc = Pop();
-			break;
-		}
-		case 0xCA:	//JZ
-			if (state.conditionCodes.z) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xCC:	//CZ addr
-			if (state.conditionCodes.z) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xCD:	//CALL addr
-		{
-			Push(state.pc + 2);
-			state.pc = Combine(inst[1], inst[2]);
-			break;
-		}
-		case 0xCE:	//ACI byte
-		{
-			uint8_t temp = state.a + inst[1] + state.conditionCodes.cy;
-			SetResultFlags(temp);
-			SetCarryFlag(static_cast<uint16_t>(static_cast<uint16_t>(state.a) + static_cast<uint16_t>(inst[1]) + state.conditionCodes.cy));
-			state.a = temp;
-			state.pc += 1;
-			break;
 		}
-		case 0xCF:	//RST 1
-		{
-			Interrupt(1);
-			break;
-		}
-		case 0xD0:	//RNC
-			if (!state.conditionCodes.cy) {
-				state.pc = Pop();
-			}
-			break;
-		case 0xD1:	//POP D
-			Split(Pop(), state.e, state.d);
-			break;
-		case 0xD2:	//JNC
-			if (!state.conditionCodes.cy) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xD3:	//OUT byte
-			WriteOutput(inst[1], state.a);
-			state.pc += 1;
-			break;
-		case 0xD4:	//CNC
-			if (!state.conditionCodes.cy) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xD5:	//PUSH D
-			Push(Combine(state.e, state.d));
-			break;
-		case 0xD6:	//SUI byte
-		{
-			uint8_t temp = state.a - inst[1];
-			SetResultFlags(temp);
-			SetCarryFlag(static_cast<uint16_t>(static_cast<uint16_t>(state.a) - static_cast<uint16_t>(inst[1])));
-			state.a = temp;
-			state.pc += 1;
-			break;
-		}
-		case 0xD7:	//RST 2
-		{
-			Interrupt(2);
-			break;
-		}
-		case 0xD8:	//RC
-			if (state.conditionCodes.cy) {
-				state.pc = Pop();
-			}
-			break;
-		case 0xDA:	//JC addr
-			if (state.conditionCodes.cy) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xDB:	//IN byte
-			state.a = ReadInput(inst[1]);
-			state.pc += 1;
-			break;
-		case 0xDC:	//CC addr
-			if (state.conditionCodes.cy) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xDE:	//SBI byte
-		{
-			uint8_t temp = state.a - inst[1] - state.conditionCodes.cy;
-			SetResultFlags(temp);
-			SetCarryFlag(static_cast<uint16_t>(static_cast<uint16_t>(state.a) - static_cast<uint16_t>(inst[1]) - state.conditionCodes.cy));
-			state.a = temp;
-			state.pc += 1;
-			break;
-		}
-		case 0xDF:	//RST 3
-		{
-			Interrupt(3);
-			break;
-		}
-		case 0xE0:	//RPO
-			if (!state.conditionCodes.p) {
-				state.pc = Pop();
-			}
-			break;
-		case 0xE1:	//POP H
-			Split(Pop(), state.l, state.h);
-			break;
-		case 0xE2:	//JPO addr
-			if (!state.conditionCodes.p) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xE3:	//XTHL
-		{
-			uint16_t temp = Combine(state.l, state.h);
-			Split(Pop(), state.l, state.h);
-			Push(temp);
-			break;
-		}
-		case 0xE4:	//CPO addr
-			if (!state.conditionCodes.p) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xE5:	//PUSH H
-			Push(Combine(state.l, state.h));
-			break;
-		case 0xE6:	//ANI byte
-		{
-			uint8_t temp = state.a & inst[1];
-			SetResultFlags(temp);
-			SetCarryFlag(static_cast<uint16_t>(temp));
-			state.a = temp;
-			state.pc += 1;
-			break;
-		}
-		case 0xE7:	//RST 4
-		{
-			Interrupt(4);
-			break;
-		}
-		case 0xE8:	//RPE
-			if (state.conditionCodes.p) {
-				state.pc = Pop();
+	} else if ((Op & 0xC7) == 0xC7) {	//RST n
+		Interrupt(y);
+	} else {
+		switch (Op) {
+			default:
+				std::cout << std::hex << std::setw(4) << state.pc << " ";
+				Disassemble(CodeAt(state.pc - 1));
+				std::cout << "\n";
+				UnrecognizedInstruction();
+				break;
+			case 0x00:	//NOP
+			case 0x08:
+			case 0x20:
+				break;
+			case 0x02:	//STAX B
+				bus.Write(state.bc.word, state.a());
+				break;
+			case 0x07:	//RLC
+				SetCarry(state.a() >> 7);
+				state.a() = (state.a() << 1) | (state.a() >> 7);
+				break;
+			case 0x0A:	//LDAX B
+				state.a() = bus.Read(state.bc.word);
+				break;
+			case 0x0F:	//RRC
+				SetCarry(state.a() & 1);
+				state.a() = (state.a() >> 1) | (state.a() << 7);
+				break;
+			case 0x12:	//STAX D
+				bus.Write(state.de.word, state.a());
+				break;
+			case 0x17:	//RAL
+			{
+				uint8_t temp = Carry();
+				SetCarry(state.a() >> 7);
+				state.a() = (state.a() << 1) | temp;
+				break;
 			}
-			break;
-		case 0xE9:	//PCHL
-			state.pc = Combine(state.l, state.h);
-			break;
-		case 0xEA:	//JPE addr
-			if (state.conditionCodes.p) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
+			case 0x1A:	//LDAX D
+				state.a() = bus.Read(state.de.word);
+				break;
+			case 0x1F:	//RAR
+			{
+				uint8_t temp = Carry();
+				SetCarry(state.a() & 1);
+				state.a() = (state.a() >> 1) | (temp << 7);
+				break;
 			}
-			break;
-		case 0xEB:	//XCHG
-		{
-			uint8_t temp1 = state.l;
-			uint8_t temp2 = state.h;
-			state.l = state.e;
-			state.h = state.d;
-			state.e = temp1;
-			state.d = temp2;
-			break;
-		}
-		case 0xEC:	//CPE addr
-			if (state.conditionCodes.p) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
+			case 0x22:	//SHLD addr
+				bus.WriteWord(operands.Word(), state.hl.word);
+				state.pc += operandBytes;
+				break;
+			case 0x27:	//DAA
+			{
+				uint8_t correction = 0;
+				uint8_t carry = Carry();
+				uint8_t lsb = state.a() & 0xF;
+				uint8_t msb = state.a() >> 4;
+				if (AuxCarry() || lsb > 9) {
+					correction |= 0x06;
+				}
+				if (carry || msb > 9 || (msb >= 9 && lsb > 9)) {
+					correction |= 0x60;
+					carry = 1;
+				}
+				state.a() = Add(state.a(), correction);
+				SetCarry(carry);
+				break;
 			}
-			break;
-		case 0xEE:	//XRI byte
-		{
-			uint8_t temp = state.a ^ inst[1];
-			SetResultFlags(temp);
-			SetCarryFlag(static_cast<uint16_t>(temp));
-			state.a = temp;
-			state.pc += 1;
-			break;
-		}
-		case 0xEF:	//RST 5
-		{
-			Interrupt(5);
-			break;
-		}
-		case 0xF0:	//RPE
-			if (state.conditionCodes.p) {
+			case 0x2A:	//LHLD addr
+				state.hl.word = bus.ReadWord(operands.Word());
+				state.pc += operandBytes;
+				break;
+			case 0x2F:	//CMA
+				state.a() = ~state.a();
+				break;
+			case 0x32:	//STA addr
+				bus.Write(operands.Word(), state.a());
+				state.pc += operandBytes;
+				break;
+			case 0x37:	//STC
+				SetCarry(1);
+				break;
+			case 0x3A:	//LDA addr
+				state.a() = bus.Read(operands.Word());
+				state.pc += operandBytes;
+				break;
+			case 0x3F:	//CMC
+				state.f() ^= FLAG_CY;
+				break;
+			case 0xC3:	//JMP addr
+				state.pc = operands.Word();
+				break;
+			case 0xC9:	//RET
 				state.pc = Pop();
+				break;
+			case 0xCD:	//CALL addr
+				Push(state.pc + operandBytes);
+				state.pc = operands.Word();
+				break;
+			case 0xD3:	//OUT byte
+				WriteOutput(operands.Byte(), state.a());
+				state.pc += operandBytes;
+				break;
+			case 0xDB:	//IN byte
+				state.a() = ReadInput(operands.Byte());
+				state.pc += operandBytes;
+				break;
+			case 0xE3:	//XTHL
+			{
+				uint16_t temp = state.hl.word;
+				state.hl.word = Pop();
+				Push(temp);
+				break;
 			}
-			break;
-		case 0xF1:	//POP PSW
-		{
-			uint8_t psw;
-			Split(Pop(), psw, state.a);
-			state.conditionCodes.cy = psw & 1;
-			state.conditionCodes.p = (psw >> 2) & 1;
-			state.conditionCodes.z = (psw >> 6) & 1;
-			state.conditionCodes.s = (psw >> 7) & 1;
-			break;
-		}
-		case 0xF2:	//JPE addr
-			if (state.conditionCodes.p) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xF3:	//DI
-			state.interruptEnable = 0;
-			break;
-		case 0xF4:	//CPE addr
-			if (state.conditionCodes.p) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
-			}
-			break;
-		case 0xF5:	//PUSH PSW
-		{
-			uint8_t psw = state.conditionCodes.s & 1;
-			psw = (psw << 1) | (state.conditionCodes.z & 1);
-			psw = (psw << 4) | (state.conditionCodes.p & 1);
-			psw = (psw << 2) | (state.conditionCodes.cy & 1);
-			Push(Combine(psw, state.a));
-			break;
-		}
-		case 0xF6:	//ORI
-		{
-			uint8_t temp = state.a | inst[1];
-			SetResultFlags(temp);
-			SetCarryFlag(static_cast<uint16_t>(temp));
-			state.a = temp;
-			state.pc += 1;
-			break;
+			case 0xE9:	//PCHL
+				state.pc = state.hl.word;
+				break;
+			case 0xEB:	//XCHG
+				std::swap(state.hl.word, state.de.word);
+				break;
+			case 0xF3:	//DI
+				state.interruptEnable = 0;
+				break;
+			case 0xFB:	//EI
+				state.interruptEnable = 1;
+				break;
 		}
-		case 0xF7:	//RST 6
-		{
-			Interrupt(6);
-			break;
+	}
+}
+
+#define EXECUTE_OPCODE(op) case 0x##op: Execute<0x##op>(operands); break;
+
+//for callers that only know the opcode at run time
+template <typename Operands>
+FORCE_INLINE void CPU::Execute(uint8_t opcode, Operands operands) {
+	switch (opcode) {
+		OPCODES(EXECUTE_OPCODE)
+	}
+}
+
+#undef EXECUTE_OPCODE
+
+//opcodes that run straight after Op when the code matches, so a fused sequence is inlined into one handler
+//and the flags one instruction writes are forwarded to the branch that reads them
+template <uint8_t Op>
+FORCE_INLINE void CPU::ExecuteFollowers(uint64_t /*target*/) {
+}
+
+//checks the same target as dispatch, so fusion never runs an instruction the interpreter wouldn't
+template <uint8_t Op>
+FORCE_INLINE bool CPU::Fuse(uint64_t target) {
+	const uint8_t* inst = CodeAt(state.pc);
+	if (cycleCount >= target || inst[0] != Op) return false;
+
+	//Fetch with the opcode known, so its cycle count is a constant
+	state.pc++;
+	instructionCount++;
+	cycleCount += cycleTable.entries[Op];
+	COUNT_OPCODE(Op);
+	Execute<Op>(MemoryOperands{ inst });
+	ExecuteFollowers<Op>(target);
+	return true;
+}
+
+#if CPU_FUSION
+
+//picked from the pairs and triples Bench reports for invaders.rom when built with CPU_OPCODE_STATS
+//sequences end at a branch, and each follower has to be specialized before anything that fuses it
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0xA7>(uint64_t target) {	//ANA A
+	Fuse<0xC2>(target) || Fuse<0xCA>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0xFE>(uint64_t target) {	//CPI
+	Fuse<0xCA>(target) || Fuse<0xC2>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0xE6>(uint64_t target) {	//ANI
+	Fuse<0xCA>(target) || Fuse<0xC2>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0x3D>(uint64_t target) {	//DCR A
+	Fuse<0xC2>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0x05>(uint64_t target) {	//DCR B
+	Fuse<0xC2>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0x23>(uint64_t target) {	//INX H
+	Fuse<0x05>(target) || Fuse<0x13>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0x77>(uint64_t target) {	//MOV M, A
+	Fuse<0x23>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0x7E>(uint64_t target) {	//MOV A, M
+	Fuse<0xA7>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0x3A>(uint64_t target) {	//LDA addr
+	Fuse<0xA7>(target) || Fuse<0x3D>(target) || Fuse<0xFE>(target) || Fuse<0xE6>(target);
+}
+
+template <>
+FORCE_INLINE void CPU::ExecuteFollowers<0xD3>(uint64_t target) {	//OUT byte
+	Fuse<0x3A>(target);
+}
+
+#endif
+
+#if CPU_DISPATCH == CPU_DISPATCH_SWITCH
+
+void CPU::Dispatch(uint64_t target) {
+	while (cycleCount < target) {
+		const uint8_t* inst = Fetch();
+		Execute(inst[0], MemoryOperands{ inst });
+	}
+}
+
+#elif CPU_DISPATCH == CPU_DISPATCH_TABLE
+
+template <uint8_t Op>
+void CPU::Handle(CPU& cpu, const uint8_t* inst, uint64_t target) {
+	cpu.Execute<Op>(MemoryOperands{ inst });
+	cpu.ExecuteFollowers<Op>(target);
+}
+
+template <size_t... Ops>
+constexpr std::array<CPU::Handler, 256> CPU::MakeHandlers(std::index_sequence<Ops...>) {
+	return { { &CPU::Handle<static_cast<uint8_t>(Ops)>... } };
+}
+
+void CPU::Dispatch(uint64_t target) {
+	static constexpr std::array<Handler, 256> handlers = MakeHandlers(std::make_index_sequence<256>{});
+
+	while (cycleCount < target) {
+		const uint8_t* inst = Fetch();
+		handlers[inst[0]](*this, inst, target);
+	}
+}
+
+#elif CPU_DISPATCH == CPU_DISPATCH_THREADED
+
+#define LABEL_ADDRESS(op) &&op_##op,
+#define LABEL_HANDLER(op) op_##op: Execute<0x##op>(MemoryOperands{ inst }); ExecuteFollowers<0x##op>(target); DISPATCH();
+
+//every handler ends in its own indirect jump, so the predictor can learn which opcode tends to follow which
+void CPU::Dispatch(uint64_t target) {
+	static void* const labels[256] = { OPCODES(LABEL_ADDRESS) };
+	const uint8_t* inst;
+
+#define DISPATCH()                 \
+	if (cycleCount >= target) return; \
+	inst = Fetch();                \
+	goto *labels[inst[0]];
+
+	DISPATCH();
+	OPCODES(LABEL_HANDLER)
+
+#undef DISPATCH
+}
+
+#undef LABEL_HANDLER
+#undef LABEL_ADDRESS
+
+#endif
+
+#undef OPCODES
+#undef OPCODES_ROW
+
+FORCE_INLINE void CPU::ExecuteDecoded(const DecodedInstruction& inst) {
+	state.pc++;
+	instructionCount++;
+	cycleCount += inst.cycles;
+	COUNT_OPCODE(inst.opcode);
+	Execute(inst.opcode, DecodedOperands{ inst.operand });
+}
+
+//entry point for code that only has the opcode and operand, like the JIT's helper calls
+void CPU::Interpret(uint8_t opcode, uint16_t operand) {
+	Execute(opcode, DecodedOperands{ operand });
+}
+
+//ROM never changes, so its code runs from predecoded blocks; code in RAM goes through the interpreter
+void CPU::RunBlocks(uint64_t target) {
+	while (cycleCount < target) {
+		if (state.pc >= ROM_SIZE) {
+			Dispatch(cycleCount + 1);
+			continue;
 		}
-		case 0xF8:	//RM
-			if (state.conditionCodes.s) {
-				state.pc = Pop();
-			}
-			break;
-		case 0xFA:	//JM addr
-			if (state.conditionCodes.s) {
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
+
+		const Block& block = GetBlock(state.pc);
+		const DecodedInstruction* inst = &decoded[block.first];
+		const DecodedInstruction* end = inst + block.count;
+
+		//only check the target per instruction when the block might cross it
+		if (cycleCount + block.cycles <= target) {
+			for (; inst != end; inst++) {
+				ExecuteDecoded(*inst);
 			}
-			break;
-		case 0xFB:	//EI
-			state.interruptEnable = 1;
-			break;
-		case 0xFC:	//CM addr
-			if (state.conditionCodes.s) {
-				Push(state.pc);
-				state.pc = Combine(inst[1], inst[2]);
-			} else {
-				state.pc += 2;
+		} else {
+			for (; inst != end && cycleCount < target; inst++) {
+				ExecuteDecoded(*inst);
 			}
-			break;
-		case 0xFE:	//CPI byte
-		{
-			uint8_t temp = state.a - inst[1];
-			SetCarryFlag(static_cast<uint16_t>(temp));
-			SetResultFlags(temp);
-			state.pc += 1;
-			break;
-		}
-		case 0xFF:	//RST 7
-		{
-			Interrupt(7);
-			break;
 		}
 	}
-}
\ No newline at end of file
+}
@@ -1,69 +1,284 @@
 #pragma once
 #include <stdint.h>
 #include <vector>
-#include <queue>
 #include <atomic>
-	
-struct ConditionCodes {
-	uint8_t z;
-	uint8_t s;
-	uint8_t p;
-	uint8_t cy;
-	uint8_t ac;
-	uint8_t pad;
+#include <array>
+#include <utility>
+#include <memory>
+#include <type_traits>
+
+#include "MemoryBus.h"
+#include "Opcodes.h"
+#ifdef CPU_OPCODE_STATS
+#include <unordered_map>
+#endif
+
+#define CPU_DISPATCH_SWITCH 0
+#define CPU_DISPATCH_TABLE 1
+#define CPU_DISPATCH_THREADED 2
+
+//select the interpreter engine at build time, eg /DCPU_DISPATCH=0 for the plain switch
+//computed goto is a GCC/Clang extension, so MSVC builds default to the handler table
+//the engines only differ inside a batch from Run, Step dispatches a single instruction
+#ifndef CPU_DISPATCH
+#if defined(__GNUC__) || defined(__clang__)
+#define CPU_DISPATCH CPU_DISPATCH_THREADED
+#else
+#define CPU_DISPATCH CPU_DISPATCH_TABLE
+#endif
+#endif
+
+#define ROM_SIZE 0x2000
+#define RAM_SIZE 0x2000
+//the board decodes 14 address lines, so ROM and RAM repeat every 16 KB
+#define MIRROR_SIZE (ROM_SIZE + RAM_SIZE)
+#define MAX_BLOCK_LENGTH 255
+
+#define CLOCK_RATE 2000000
+#define HALF_FRAME_CYCLES 16667
+#define FRAME_CYCLES (2 * HALF_FRAME_CYCLES)
+//pushing pc and jumping to the RST vector
+#define INTERRUPT_CYCLES 11
+
+//player controls on input port 1, bit 3 is tied high on the board
+#define INPUT_PORT_PLAYER 1
+#define INPUT_COIN 0x01
+#define INPUT_P2_START 0x02
+#define INPUT_P1_START 0x04
+#define INPUT_ALWAYS_ON 0x08
+#define INPUT_P1_FIRE 0x10
+#define INPUT_P1_LEFT 0x20
+#define INPUT_P1_RIGHT 0x40
+
+//defer computing condition codes until a branch, PUSH PSW or DAA reads them
+#ifndef CPU_LAZY_FLAGS
+#define CPU_LAZY_FLAGS 1
+#endif
+
+//let the threaded and table interpreters run common opcode sequences without dispatching between them
+#ifndef CPU_FUSION
+#define CPU_FUSION 1
+#endif
+
+//run code in the ROM region from predecoded basic blocks
+#ifndef CPU_BLOCK_CACHE
+#define CPU_BLOCK_CACHE 0
+#endif
+
+//link in Recompiled.cpp, generated from invaders.rom by the Recompiler tool
+#ifndef CPU_RECOMPILED
+#define CPU_RECOMPILED 0
+#endif
+
+//MSVC only targets little-endian hosts
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_BIG_ENDIAN 1
+#else
+#define HOST_BIG_ENDIAN 0
+#endif
+
+#ifdef _MSC_VER
+#define FORCE_INLINE __forceinline
+#else
+#define FORCE_INLINE inline __attribute__((always_inline))
+#endif
+
+//a register pair, readable as one 16-bit word or as its two halves
+union RegisterPair {
+	uint16_t word;
+	struct {
+#if HOST_BIG_ENDIAN
+		uint8_t high;
+		uint8_t low;
+#else
+		uint8_t low;
+		uint8_t high;
+#endif
+	} bytes;
+};
+
+//the last ALU result, from which Z, S, P and AC are derived when something reads them
+struct LazyFlags {
+	uint8_t result;
+	uint8_t aux;
+	uint8_t pending;
 };
 
+//the pairs come first so every register an instruction touches sits in one cache line
+//PSW is A and the flags byte F, which uses the bit layout PUSH PSW writes
 struct State {
-	uint8_t a;
-	uint8_t b;
-	uint8_t c;
-	uint8_t d;
-	uint8_t e;
-	uint8_t h;
-	uint8_t l;
+	RegisterPair bc;
+	RegisterPair de;
+	RegisterPair hl;
+	RegisterPair psw;
 	uint16_t sp;
 	uint16_t pc;
+	LazyFlags lazyFlags;
+	uint8_t interruptEnable;
+	//ROM then RAM, as the bus maps them below 0x4000
 	std::vector<uint8_t> memory;
-	ConditionCodes conditionCodes;
+
+	uint8_t& a() { return psw.bytes.high; }
+	uint8_t& f() { return psw.bytes.low; }
+	uint8_t& b() { return bc.bytes.high; }
+	uint8_t& c() { return bc.bytes.low; }
+	uint8_t& d() { return de.bytes.high; }
+	uint8_t& e() { return de.bytes.low; }
+	uint8_t& h() { return hl.bytes.high; }
+	uint8_t& l() { return hl.bytes.low; }
+};
+
+//everything a running machine changes, flat so saving or loading it is a copy
+//ROM and the caches decoded from it are left out, so a snapshot only loads into a CPU running the same ROM
+struct Snapshot {
+	RegisterPair bc;
+	RegisterPair de;
+	RegisterPair hl;
+	RegisterPair psw;
+	uint16_t sp;
+	uint16_t pc;
+	LazyFlags lazyFlags;
 	uint8_t interruptEnable;
+	uint8_t nextInterruptValue;
+	uint8_t inputs[4];
+	uint8_t outputs[7];
+	uint16_t shiftRegister;
+	uint64_t instructionCount;
+	uint64_t cycleCount;
+	uint64_t cycleLimit;
+	uint64_t nextInterruptCycle;
+	uint8_t ram[RAM_SIZE];
 };
 
+static_assert(std::is_trivially_copyable<Snapshot>::value, "snapshots are saved and loaded with memcpy");
+
+//operand bytes read straight from memory, after the opcode
+struct MemoryOperands {
+	const uint8_t* inst;
+
+	uint8_t Byte() const { return inst[1]; }
+	uint16_t Word() const { return static_cast<uint16_t>(inst[1] | (inst[2] << 8)); }
+};
+
+//operand predecoded into a little-endian word
+struct DecodedOperands {
+	uint16_t word;
+
+	uint8_t Byte() const { return static_cast<uint8_t>(word); }
+	uint16_t Word() const { return word; }
+};
+
+class Jit;
+
 class CPU {
+	friend class Jit;
+
 public:
 	CPU();
-	void LoadROM(size_t size, void* data);
+	~CPU();
+	void LoadROM(size_t size, const void* data);
 	void Step();
+	uint64_t Run(uint64_t budget);
 	void* GetRAM(size_t index) { return &state.memory[index]; }
+	const void* GetRAM(size_t index) const { return &state.memory[index]; }
+	MemoryBus& GetBus() { return bus; }
+	//F is brought up to date first, so it holds every flag
+	const State& GetState();
+	//frames added but not yet run belong to the caller's clock, so loading leaves them pending
+	void SaveState(Snapshot& snapshot) const;
+	void LoadState(const Snapshot& snapshot);
 	void SetInput(size_t index, uint8_t value);
 	uint8_t GetOutput(size_t index);
 	void AddFrame();
+	//runs exactly one more frame of cycles, for callers that own the clock instead of a render loop calling AddFrame
+	//the frame ends on the same instruction however the engine runs it, so inputs set between frames replay exactly
+	uint64_t RunFrame();
+	bool EnableJit(bool enable);
+	bool IsJitEnabled() const { return jit != nullptr; }
+	bool EnableRecompiled(bool enable);
+	bool IsRecompiledEnabled() const { return recompiled; }
+	uint64_t GetCycleCount() const { return cycleCount; }
+	uint64_t GetInstructionCount() const { return instructionCount; }
+
+#ifdef CPU_FLAG_STATS
+	struct FlagStats {
+		uint64_t updates;
+		uint64_t materializations;
+	};
+	const FlagStats& GetFlagStats() const { return flagStats; }
+#endif
+
+#ifdef CPU_OPCODE_STATS
+	//how often each sequence of opcodes ran in the interpreter, keyed by the opcodes packed oldest first
+	struct OpcodeStats {
+		std::vector<uint64_t> pairs = std::vector<uint64_t>(0x10000);
+		std::unordered_map<uint32_t, uint64_t> triples;
+		uint32_t history = 0;
+		uint32_t seen = 0;
+	};
+	const OpcodeStats& GetOpcodeStats() const { return opcodeStats; }
+#endif
 
 private:
-	struct Interrupt_t {
-		size_t value;
-		size_t target;
+
+	typedef void (*Handler)(CPU& cpu, const uint8_t* inst, uint64_t target);
+
+	struct DecodedInstruction {
+		uint8_t opcode;
+		uint8_t cycles;
+		uint16_t operand;
 	};
+
+	struct Block {
+		uint32_t first;
+		uint16_t count;
+		uint16_t cycles;
+	};
+
 	State state;
-	size_t instructionCount = 0;
-	std::atomic<uint32_t> frameCount;
-	std::queue<Interrupt_t> queue;
+	MemoryBus bus;
+	uint64_t instructionCount = 0;
+	uint64_t cycleCount = 0;
+	uint64_t cycleLimit = 0;
+	uint64_t nextInterruptCycle = HALF_FRAME_CYCLES;
+	uint8_t nextInterruptValue = 1;
+	std::atomic<uint32_t> frameCount{ 0 };
 
-	uint8_t inputs[4];
-	uint8_t outputs[7];
+	std::vector<Block> blocks;
+	std::vector<DecodedInstruction> decoded;
+	std::unique_ptr<Jit> jit;
+	bool recompiled = false;
+
+	uint8_t inputs[4] = {};
+	uint8_t outputs[7] = {};
 	uint16_t shiftRegister;
+#ifdef CPU_FLAG_STATS
+	FlagStats flagStats = {};
+#endif
+#ifdef CPU_OPCODE_STATS
+	OpcodeStats opcodeStats;
+
+	void CountOpcode(uint8_t opcode);
+#endif
 
 	void UnrecognizedInstruction();
-	uint16_t Combine(uint8_t low, uint8_t high);
-	void Split(uint16_t value, uint8_t& low, uint8_t& high);
-	uint8_t CheckParity(uint8_t result);
-	void SetResultFlags(uint8_t result);
-	void SetCarryFlag(uint16_t result);
-	void SetCarryFlag(uint32_t result);
-	void SetAuxCarryFlag(uint8_t a, uint8_t b);
+	void SetResultFlags(uint8_t result, uint8_t aux);
+	void MaterializeFlags();
+	uint8_t Zero();
+	uint8_t Sign();
+	uint8_t Parity();
+	uint8_t AuxCarry();
+	uint8_t Carry();
+	void SetCarry(uint8_t carry);
+	uint8_t AddWithCarry(uint8_t a, uint8_t b, uint8_t carry);
+	uint8_t SubtractWithBorrow(uint8_t a, uint8_t b, uint8_t borrow);
 	uint8_t Add(uint8_t a, uint8_t b);
 	uint16_t Add(uint16_t a, uint16_t b);
 	uint8_t ADC(uint8_t a, uint8_t b);
+	uint8_t SUB(uint8_t a, uint8_t b);
 	uint8_t SBB(uint8_t a, uint8_t b);
+	uint8_t INR(uint8_t value);
+	uint8_t DCR(uint8_t value);
 	uint8_t ANA(uint8_t a, uint8_t b);
 	uint8_t XRA(uint8_t a, uint8_t b);
 	uint8_t ORA(uint8_t a, uint8_t b);
@@ -72,7 +287,43 @@ private:
 	uint16_t Pop();
 	uint8_t ReadInput(uint8_t index);
 	void WriteOutput(uint8_t index, uint8_t value);
-	void QueueInterrupt(size_t value, size_t instructionDelay);
+	void CheckInterrupt();
 	void Interrupt(size_t value);
+	const uint8_t* CodeAt(uint16_t address) const;
+	const uint8_t* Fetch();
+	void Dispatch(uint64_t target);
+	const Block& GetBlock(uint16_t pc);
+	void DecodeBlock(uint16_t pc, Block& block);
+	void RunBlocks(uint64_t target);
+	void ExecuteDecoded(const DecodedInstruction& inst);
+	void Interpret(uint8_t opcode, uint16_t operand);
+#if CPU_RECOMPILED
+	bool MatchesRecompiledROM() const;
+	void RunRecompiled(uint64_t target);
+#endif
+	template <uint8_t R>
+	uint8_t GetRegister();
+	template <uint8_t R>
+	void SetRegister(uint8_t value);
+	template <uint8_t P>
+	uint16_t& Pair();
+	template <uint8_t C>
+	bool Condition();
+	template <uint8_t O>
+	void Arithmetic(uint8_t value);
+	template <uint8_t Op, typename Operands>
+	void Execute(Operands operands);
+	template <typename Operands>
+	void Execute(uint8_t opcode, Operands operands);
+
+	template <uint8_t Op>
+	void ExecuteFollowers(uint64_t target);
+	template <uint8_t Op>
+	bool Fuse(uint64_t target);
+
+	template <uint8_t Op>
+	static void Handle(CPU& cpu, const uint8_t* inst, uint64_t target);
+	template <size_t... Ops>
+	static constexpr std::array<Handler, 256> MakeHandlers(std::index_sequence<Ops...>);
 };
 
@@ -1,13 +1,85 @@
 #include "Display.h"
+#include <cstring>
+
+//set in the waiting index when it holds a frame ConvertImage hasn't taken yet
+#define FRAME_FRESH 0x80
+#define FRAME_INDEX 0x03
 
 Display::Display(CPU& cpu) : cpu(cpu) {
-	vram = reinterpret_cast<uint8_t*>(cpu.GetRAM(0x2400));
+	vram = reinterpret_cast<uint8_t*>(cpu.GetRAM(VRAM_ADDR));
 	image.resize(IMAGE_WIDTH * IMAGE_HEIGHT);
+
+	//the first frame converts everything
+	Invalidate();
+
+	//VRAM stays mapped straight onto RAM, the bus marks the row of every store so a frame only converts and uploads what changed
+	for (uint32_t base = 0; base < 0x10000; base += MIRROR_SIZE) {
+		cpu.GetBus().MarkWrites(static_cast<uint16_t>(base + VRAM_ADDR), VRAM_SIZE, dirtyRows);
+	}
 }
 
 void Display::ConvertImage() {
-	for (size_t i = 0; i < VRAM_SIZE; i++) {
-		ConvertByte(vram[i], &image[i * 8]);
+	changedRows.reset();
+	if (published) {
+		TakePublished();
+		return;
+	}
+
+	for (size_t row = 0; row < IMAGE_HEIGHT; row++) {
+		if (!dirtyRows[row]) continue;
+		dirtyRows[row] = 0;
+
+		ConvertRow(vram, row);
+		changedRows.set(row);
+	}
+}
+
+//a frame still waiting was never converted, so its rows are carried into the one replacing it
+//reading it is safe even if ConvertImage takes it meanwhile, that side only reads too, and at worst rows are converted twice
+void Display::Publish() {
+	Frame& frame = frames[back];
+	memcpy(frame.vram, vram, VRAM_SIZE);
+	frame.number = ++publishCount;
+
+	frame.rows.reset();
+	for (size_t row = 0; row < IMAGE_HEIGHT; row++) {
+		if (!dirtyRows[row]) continue;
+		dirtyRows[row] = 0;
+		frame.rows.set(row);
+	}
+
+	uint8_t stale = waiting.load(std::memory_order_acquire);
+	if (stale & FRAME_FRESH) frame.rows |= frames[stale & FRAME_INDEX].rows;
+
+	back = waiting.exchange(back | FRAME_FRESH, std::memory_order_acq_rel) & FRAME_INDEX;
+}
+
+//with nothing new the image stays as it is and no rows changed
+void Display::TakePublished() {
+	if (!(waiting.load(std::memory_order_relaxed) & FRAME_FRESH)) return;
+	front = waiting.exchange(front, std::memory_order_acq_rel) & FRAME_INDEX;
+
+	const Frame& frame = frames[front];
+	for (size_t row = 0; row < IMAGE_HEIGHT; row++) {
+		if (frame.rows[row]) ConvertRow(frame.vram, row);
+	}
+	changedRows = frame.rows;
+	frameNumber = frame.number;
+}
+
+void Display::ConvertRow(const uint8_t* source, size_t row) {
+	for (size_t i = row * ROW_BYTES; i < (row + 1) * ROW_BYTES; i++) {
+		ConvertByte(source[i], &image[i * 8]);
+	}
+}
+
+void Display::Invalidate() {
+	memset(dirtyRows, 1, sizeof(dirtyRows));
+}
+
+void Display::Invalidate(const RowSet& rows) {
+	for (size_t row = 0; row < IMAGE_HEIGHT; row++) {
+		if (rows[row]) dirtyRows[row] = 1;
 	}
 }
 
@@ -21,4 +93,4 @@ void Display::ConvertByte(uint8_t source, Color4* dest) {
 
 		source >>= 1;
 	}
-}
+}
\ No newline at end of file
@@ -1,11 +1,16 @@
 #pragma once
 #include "CPU.h"
 #include <vector>
+#include <atomic>
+#include <bitset>
 
 #define VRAM_ADDR 0x2400
 #define VRAM_SIZE (7 * 1024)
 #define IMAGE_WIDTH 256
 #define IMAGE_HEIGHT 224
+#define ROW_BYTES (IMAGE_WIDTH / 8)
+
+static_assert((1 << WRITE_MARK_SHIFT) == ROW_BYTES, "the bus marks VRAM a row at a time");
 
 struct Color4 {
 	uint8_t r;
@@ -14,17 +19,54 @@ struct Color4 {
 	uint8_t a;
 };
 
+//one bit per image row
+typedef std::bitset<IMAGE_HEIGHT> RowSet;
+
 class Display {
 public:
 	Display(CPU& cpu);
 
+	//converts the rows written since the last call, or since the last published frame taken
 	void ConvertImage();
+	//ConvertImage takes the newest frame Publish handed over instead of reading VRAM, set before the CPU runs on another thread
+	void UsePublishedFrames() { published = true; }
+	//called by the thread running the CPU at VBlank, copies VRAM out so the other thread never reads it mid frame
+	void Publish();
+	//converts every row next time, after VRAM changed without going through the bus
+	void Invalidate();
+	void Invalidate(const RowSet& rows);
 	const std::vector<Color4>& GetImage() const { return image; }
+	const RowSet& GetChangedRows() const { return changedRows; }
+	//the published frame the image shows, counted from 1, 0 before the first is taken
+	uint64_t GetFrameNumber() const { return frameNumber; }
 
 private:
+	struct Frame {
+		uint8_t vram[VRAM_SIZE];
+		//rows that differ from the frame ConvertImage took before this one
+		RowSet rows;
+		uint64_t number;
+	};
+
 	CPU& cpu;
 	uint8_t* vram;
 	std::vector<Color4> image;
+	//marked by the bus on every store to VRAM, cleared by ConvertImage, or by Publish once frames are published
+	//both run on the thread that runs the CPU, so these are plain bytes the JIT can store to inline
+	uint8_t dirtyRows[IMAGE_HEIGHT];
+	RowSet changedRows;
+
+	//triple buffer, Publish fills back while ConvertImage reads front and the newest finished frame waits between them
+	//the two sides only meet in one exchange of the waiting index, so neither ever waits on the other
+	bool published = false;
+	Frame frames[3] = {};
+	uint8_t back = 0;
+	uint8_t front = 1;
+	std::atomic<uint8_t> waiting{ 2 };
+	uint64_t publishCount = 0;
+	uint64_t frameNumber = 0;
+
+	void TakePublished();
+	void ConvertRow(const uint8_t* source, size_t row);
 	void ConvertByte(uint8_t source, Color4* dest);
 };
-
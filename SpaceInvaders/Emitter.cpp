@@ -0,0 +1,311 @@
+#include "Emitter.h"
+
+#include <string.h>
+
+//SPL, BPL, SIL and DIL need a REX prefix, without one those encodings mean AH, CH, DH and BH
+static bool NeedsRexForByte(uint8_t reg) {
+	return reg >= 4 && reg < 8;
+}
+
+void Emitter::Byte(uint8_t value) {
+	*code++ = value;
+}
+
+void Emitter::Word(uint16_t value) {
+	memcpy(code, &value, sizeof(value));
+	code += sizeof(value);
+}
+
+void Emitter::Dword(uint32_t value) {
+	memcpy(code, &value, sizeof(value));
+	code += sizeof(value);
+}
+
+void Emitter::Qword(uint64_t value) {
+	memcpy(code, &value, sizeof(value));
+	code += sizeof(value);
+}
+
+void Emitter::Rex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool byteRegs) {
+	if (index == NO_REG) index = 0;
+	uint8_t rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (base >> 3);
+	if (rex != 0x40 || byteRegs) {
+		Byte(rex);
+	}
+}
+
+void Emitter::ModRR(uint8_t reg, uint8_t rm) {
+	Byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+void Emitter::ModMem(uint8_t reg, Mem mem) {
+	uint8_t base = mem.base & 7;
+	uint8_t mod;
+	//RBP and R13 as a base always need a displacement
+	if (mem.disp == 0 && base != 5) mod = 0;
+	else if (mem.disp >= -128 && mem.disp <= 127) mod = 1;
+	else mod = 2;
+
+	if (mem.index != NO_REG) {
+		Byte((mod << 6) | ((reg & 7) << 3) | 4);
+		Byte((mem.scale << 6) | ((mem.index & 7) << 3) | base);
+	} else {
+		Byte((mod << 6) | ((reg & 7) << 3) | base);
+		//RSP and R12 as a base need a SIB byte
+		if (base == 4) Byte(0x24);
+	}
+
+	if (mod == 1) Byte(static_cast<uint8_t>(mem.disp));
+	else if (mod == 2) Dword(static_cast<uint32_t>(mem.disp));
+}
+
+void Emitter::OpRR(uint8_t opcode, uint8_t reg, Reg rm, bool wide, bool byteRegs) {
+	Rex(wide, reg, 0, rm, byteRegs && (NeedsRexForByte(reg) || NeedsRexForByte(rm)));
+	Byte(opcode);
+	ModRR(reg, rm);
+}
+
+void Emitter::OpMem(uint8_t opcode, uint8_t reg, Mem mem, bool wide, bool byteReg) {
+	Rex(wide, reg, mem.index, mem.base, byteReg && NeedsRexForByte(reg));
+	Byte(opcode);
+	ModMem(reg, mem);
+}
+
+void Emitter::Op0F(uint8_t opcode, uint8_t reg, Reg rm, bool byteRm) {
+	Rex(false, reg, 0, rm, byteRm && NeedsRexForByte(rm));
+	Byte(0x0F);
+	Byte(opcode);
+	ModRR(reg, rm);
+}
+
+void Emitter::Op0FMem(uint8_t opcode, uint8_t reg, Mem mem) {
+	Rex(false, reg, mem.index, mem.base, false);
+	Byte(0x0F);
+	Byte(opcode);
+	ModMem(reg, mem);
+}
+
+void Emitter::MovRR32(Reg dst, Reg src) {
+	OpRR(0x89, src, dst, false, false);
+}
+
+void Emitter::MovRR64(Reg dst, Reg src) {
+	OpRR(0x89, src, dst, true, false);
+}
+
+void Emitter::MovRI32(Reg dst, uint32_t imm) {
+	Rex(false, 0, 0, dst, false);
+	Byte(0xB8 + (dst & 7));
+	Dword(imm);
+}
+
+void Emitter::MovRI64(Reg dst, uint64_t imm) {
+	Rex(true, 0, 0, dst, false);
+	Byte(0xB8 + (dst & 7));
+	Qword(imm);
+}
+
+void Emitter::Load64(Reg dst, Mem src) {
+	OpMem(0x8B, dst, src, true, false);
+}
+
+void Emitter::Store64(Mem dst, Reg src) {
+	OpMem(0x89, src, dst, true, false);
+}
+
+void Emitter::LoadZX8(Reg dst, Mem src) {
+	Op0FMem(0xB6, dst, src);
+}
+
+void Emitter::LoadZX16(Reg dst, Mem src) {
+	Op0FMem(0xB7, dst, src);
+}
+
+void Emitter::Store8(Mem dst, Reg src) {
+	OpMem(0x88, src, dst, false, true);
+}
+
+void Emitter::Store16(Mem dst, Reg src) {
+	Byte(0x66);
+	OpMem(0x89, src, dst, false, false);
+}
+
+void Emitter::Store8I(Mem dst, uint8_t imm) {
+	OpMem(0xC6, 0, dst, false, false);
+	Byte(imm);
+}
+
+void Emitter::Store16I(Mem dst, uint16_t imm) {
+	Byte(0x66);
+	OpMem(0xC7, 0, dst, false, false);
+	Word(imm);
+}
+
+void Emitter::MovZX8(Reg dst, Reg src) {
+	Op0F(0xB6, dst, src, true);
+}
+
+//movzx dst, ah, only encodable without a REX prefix
+void Emitter::MovZXAH(Reg dst) {
+	Byte(0x0F);
+	Byte(0xB6);
+	ModRR(dst, 4);
+}
+
+void Emitter::XchgRR32(Reg a, Reg b) {
+	OpRR(0x87, a, b, false, false);
+}
+
+void Emitter::Alu8RR(AluOp op, Reg dst, Reg src) {
+	OpRR(op, src, dst, false, true);
+}
+
+void Emitter::Alu8RI(AluOp op, Reg dst, uint8_t imm) {
+	if (dst == RAX) {
+		Byte(op + 4);
+	} else {
+		Rex(false, 0, 0, dst, NeedsRexForByte(dst));
+		Byte(0x80);
+		ModRR(op >> 3, dst);
+	}
+	Byte(imm);
+}
+
+void Emitter::Alu8MI(AluOp op, Mem dst, uint8_t imm) {
+	OpMem(0x80, op >> 3, dst, false, false);
+	Byte(imm);
+}
+
+void Emitter::Alu8MR(AluOp op, Mem dst, Reg src) {
+	OpMem(op, src, dst, false, true);
+}
+
+void Emitter::Alu32RR(AluOp op, Reg dst, Reg src) {
+	OpRR(op + 1, src, dst, false, false);
+}
+
+void Emitter::Alu32RI(AluOp op, Reg dst, uint32_t imm) {
+	OpRR(0x81, op >> 3, dst, false, false);
+	Dword(imm);
+}
+
+void Emitter::Alu64RI(AluOp op, Reg dst, int32_t imm) {
+	OpRR(0x81, op >> 3, dst, true, false);
+	Dword(static_cast<uint32_t>(imm));
+}
+
+void Emitter::Alu64RM(AluOp op, Reg dst, Mem src) {
+	OpMem(op + 3, dst, src, true, false);
+}
+
+void Emitter::Alu64MI(AluOp op, Mem dst, int32_t imm) {
+	OpMem(0x81, op >> 3, dst, true, false);
+	Dword(static_cast<uint32_t>(imm));
+}
+
+void Emitter::Shift8(ShiftOp op, Reg reg) {
+	Rex(false, 0, 0, reg, NeedsRexForByte(reg));
+	Byte(0xD0);
+	ModRR(op, reg);
+}
+
+void Emitter::Shift32RI(ShiftOp op, Reg reg, uint8_t imm) {
+	OpRR(0xC1, op, reg, false, false);
+	Byte(imm);
+}
+
+void Emitter::Inc8(Reg reg) {
+	Rex(false, 0, 0, reg, NeedsRexForByte(reg));
+	Byte(0xFE);
+	ModRR(0, reg);
+}
+
+void Emitter::Dec8(Reg reg) {
+	Rex(false, 0, 0, reg, NeedsRexForByte(reg));
+	Byte(0xFE);
+	ModRR(1, reg);
+}
+
+void Emitter::Not32(Reg reg) {
+	OpRR(0xF7, 2, reg, false, false);
+}
+
+void Emitter::Test32(Reg a, Reg b) {
+	OpRR(0x85, b, a, false, false);
+}
+
+void Emitter::Test64(Reg a, Reg b) {
+	OpRR(0x85, b, a, true, false);
+}
+
+void Emitter::Test8(Reg a, Reg b) {
+	OpRR(0x84, b, a, false, true);
+}
+
+void Emitter::Bt32(Reg reg, uint8_t bit) {
+	Op0F(0xBA, 4, reg, false);
+	Byte(bit);
+}
+
+void Emitter::Lahf() {
+	Byte(0x9F);
+}
+
+void Emitter::Sahf() {
+	Byte(0x9E);
+}
+
+void Emitter::SetR(Cond cond, Reg dst) {
+	Op0F(0x90 + cond, 0, dst, true);
+}
+
+void Emitter::SetM(Cond cond, Mem dst) {
+	Op0FMem(0x90 + cond, 0, dst);
+}
+
+uint8_t* Emitter::Jmp() {
+	Byte(0xE9);
+	uint8_t* field = code;
+	Dword(0);
+	return field;
+}
+
+uint8_t* Emitter::Jcc(Cond cond) {
+	Byte(0x0F);
+	Byte(0x80 + cond);
+	uint8_t* field = code;
+	Dword(0);
+	return field;
+}
+
+void Emitter::JmpTo(const uint8_t* target) {
+	Link(Jmp(), target);
+}
+
+void Emitter::JmpR(Reg reg) {
+	OpRR(0xFF, 4, reg, false, false);
+}
+
+void Emitter::Call(const void* function) {
+	MovRI64(RAX, reinterpret_cast<uint64_t>(function));
+	OpRR(0xFF, 2, RAX, false, false);
+}
+
+void Emitter::Push(Reg reg) {
+	Rex(false, 0, 0, reg, false);
+	Byte(0x50 + (reg & 7));
+}
+
+void Emitter::Pop(Reg reg) {
+	Rex(false, 0, 0, reg, false);
+	Byte(0x58 + (reg & 7));
+}
+
+void Emitter::Ret() {
+	Byte(0xC3);
+}
+
+void Emitter::Link(uint8_t* field, const uint8_t* target) {
+	int32_t offset = static_cast<int32_t>(target - (field + 4));
+	memcpy(field, &offset, sizeof(offset));
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <stdint.h>
+
+//a minimal x86-64 assembler, just the forms the JIT needs
+
+enum Reg : uint8_t {
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15,
+	NO_REG = 0xFF
+};
+
+//condition field of Jcc and SETcc
+enum Cond : uint8_t {
+	COND_B = 0x2,
+	COND_AE = 0x3,
+	COND_E = 0x4,
+	COND_NE = 0x5,
+	COND_A = 0x7,
+	COND_S = 0x8,
+	COND_NS = 0x9,
+	COND_P = 0xA,
+	COND_NP = 0xB
+};
+
+//the /r opcode of each 8-bit ALU operation, the /digit extension is this shifted right by 3
+enum AluOp : uint8_t {
+	ALU_ADD = 0x00,
+	ALU_OR = 0x08,
+	ALU_ADC = 0x10,
+	ALU_SBB = 0x18,
+	ALU_AND = 0x20,
+	ALU_SUB = 0x28,
+	ALU_XOR = 0x30,
+	ALU_CMP = 0x38
+};
+
+enum ShiftOp : uint8_t {
+	SHIFT_ROL = 0,
+	SHIFT_ROR = 1,
+	SHIFT_RCL = 2,
+	SHIFT_RCR = 3,
+	SHIFT_SHL = 4,
+	SHIFT_SHR = 5
+};
+
+//[base + (index << scale) + disp]
+struct Mem {
+	Reg base = NO_REG;
+	Reg index = NO_REG;
+	int32_t disp = 0;
+	uint8_t scale = 0;
+};
+
+class Emitter {
+public:
+	Emitter(uint8_t* code) : code(code) {}
+
+	uint8_t* Position() const { return code; }
+	void SetPosition(uint8_t* position) { code = position; }
+
+	void MovRR32(Reg dst, Reg src);
+	void MovRR64(Reg dst, Reg src);
+	void MovRI32(Reg dst, uint32_t imm);
+	void MovRI64(Reg dst, uint64_t imm);
+	void Load64(Reg dst, Mem src);
+	void Store64(Mem dst, Reg src);
+	void LoadZX8(Reg dst, Mem src);
+	void LoadZX16(Reg dst, Mem src);
+	void Store8(Mem dst, Reg src);
+	void Store16(Mem dst, Reg src);
+	void Store8I(Mem dst, uint8_t imm);
+	void Store16I(Mem dst, uint16_t imm);
+	void MovZX8(Reg dst, Reg src);
+	void MovZXAH(Reg dst);
+	void XchgRR32(Reg a, Reg b);
+
+	void Alu8RR(AluOp op, Reg dst, Reg src);
+	void Alu8RI(AluOp op, Reg dst, uint8_t imm);
+	void Alu8MI(AluOp op, Mem dst, uint8_t imm);
+	void Alu8MR(AluOp op, Mem dst, Reg src);
+	void Alu32RR(AluOp op, Reg dst, Reg src);
+	void Alu32RI(AluOp op, Reg dst, uint32_t imm);
+	void Alu64RI(AluOp op, Reg dst, int32_t imm);
+	void Alu64RM(AluOp op, Reg dst, Mem src);
+	void Alu64MI(AluOp op, Mem dst, int32_t imm);
+	void Shift8(ShiftOp op, Reg reg);
+	void Shift32RI(ShiftOp op, Reg reg, uint8_t imm);
+	void Inc8(Reg reg);
+	void Dec8(Reg reg);
+	void Not32(Reg reg);
+	void Test32(Reg a, Reg b);
+	void Test64(Reg a, Reg b);
+	void Test8(Reg a, Reg b);
+	void Bt32(Reg reg, uint8_t bit);
+	void Lahf();
+	void Sahf();
+	void SetR(Cond cond, Reg dst);
+	void SetM(Cond cond, Mem dst);
+
+	uint8_t* Jmp();
+	uint8_t* Jcc(Cond cond);
+	void JmpTo(const uint8_t* target);
+	void JmpR(Reg reg);
+	void Call(const void* function);
+	void Push(Reg reg);
+	void Pop(Reg reg);
+	void Ret();
+
+	//point the rel32 field returned by Jmp or Jcc at target
+	static void Link(uint8_t* field, const uint8_t* target);
+
+private:
+	uint8_t* code;
+
+	void Byte(uint8_t value);
+	void Word(uint16_t value);
+	void Dword(uint32_t value);
+	void Qword(uint64_t value);
+	void Rex(bool wide, uint8_t reg, uint8_t index, uint8_t base, bool byteRegs);
+	void ModRR(uint8_t reg, uint8_t rm);
+	void ModMem(uint8_t reg, Mem mem);
+	void OpRR(uint8_t opcode, uint8_t reg, Reg rm, bool wide, bool byteRegs);
+	void OpMem(uint8_t opcode, uint8_t reg, Mem mem, bool wide, bool byteReg);
+	void Op0F(uint8_t opcode, uint8_t reg, Reg rm, bool byteRm);
+	void Op0FMem(uint8_t opcode, uint8_t reg, Mem mem);
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdint.h>
+
+//lookup tables for the 8080 condition codes, generated at compile time
+
+//bits of the flags byte F, as PUSH PSW stores it
+#define FLAG_CY 0x01
+#define FLAG_ONE 0x02
+#define FLAG_P 0x04
+#define FLAG_AC 0x10
+#define FLAG_Z 0x40
+#define FLAG_S 0x80
+//bit 1 always reads 1 and bits 3 and 5 always read 0
+#define FLAG_MASK (FLAG_CY | FLAG_P | FLAG_AC | FLAG_Z | FLAG_S)
+
+struct IncDecResult {
+	uint8_t result;
+	//AC, already in bit 4 like the aux argument of SetResultFlags
+	uint8_t aux;
+};
+
+constexpr uint8_t ComputeParity(uint8_t value) {
+	uint8_t bits = 0;
+	for (int i = 0; i < 8; i++) {
+		bits += (value >> i) & 1;
+	}
+	return !(bits & 1);
+}
+
+constexpr uint8_t ComputeResultFlags(uint8_t value) {
+	return static_cast<uint8_t>((value & FLAG_S) | (value == 0 ? FLAG_Z : 0) | (ComputeParity(value) ? FLAG_P : 0));
+}
+
+//Z, S and P depend only on the 8-bit result, each entry holds them in their F bit positions
+struct ResultFlagsTable {
+	uint8_t entries[256];
+
+	constexpr ResultFlagsTable() : entries() {
+		for (int i = 0; i < 256; i++) {
+			entries[i] = ComputeResultFlags(static_cast<uint8_t>(i));
+		}
+	}
+};
+
+//INR and DCR leave CY alone, so the result and AC are a function of the operand
+struct IncDecTable {
+	IncDecResult entries[256];
+
+	constexpr IncDecTable(int delta) : entries() {
+		for (int i = 0; i < 256; i++) {
+			uint8_t result = static_cast<uint8_t>(i + delta);
+			//DCR is an add of 0xFF, so it carries out of bit 3 unless the low nibble was 0
+			bool ac = delta > 0 ? (i & 0xF) == 0xF : (i & 0xF) != 0;
+			entries[i] = { result, static_cast<uint8_t>(ac ? FLAG_AC : 0) };
+		}
+	}
+};
+
+static constexpr ResultFlagsTable resultFlagsTable = ResultFlagsTable();
+static constexpr IncDecTable incrementTable = IncDecTable(1);
+static constexpr IncDecTable decrementTable = IncDecTable(-1);
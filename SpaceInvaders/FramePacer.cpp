@@ -0,0 +1,75 @@
+#include "FramePacer.h"
+#include <thread>
+#include <cmath>
+#include <algorithm>
+
+//Windows sleeps to the next 15.6 ms timer tick unless a finer one is asked for
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#endif
+
+FramePacer::FramePacer(double speed) : speed(speed > 0 ? speed : 1.0) {
+	period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(static_cast<double>(FRAME_CYCLES) / CLOCK_RATE / this->speed));
+	start = Clock::now();
+#ifdef _WIN32
+	timeBeginPeriod(1);
+#endif
+}
+
+FramePacer::~FramePacer() {
+#ifdef _WIN32
+	timeEndPeriod(1);
+#endif
+}
+
+void FramePacer::Start() {
+	start = Clock::now();
+	frameIndex = 0;
+}
+
+//the deadline is worked out from the frame index rather than added to, so rounding doesn't drift either
+void FramePacer::Wait() {
+	frameIndex++;
+	Clock::time_point deadline = start + period * frameIndex;
+
+	Clock::time_point now = Clock::now();
+	if (now - deadline > period * PACER_MAX_LAG_FRAMES) {
+		start = now;
+		frameIndex = 0;
+		resyncs++;
+		return;
+	}
+
+	SleepUntil(deadline);
+
+	double jitter = std::chrono::duration<double, std::micro>(Clock::now() - deadline).count();
+	jitter = std::max(jitter, 0.0);
+	jitterTotal += jitter;
+	jitterMax = std::max(jitterMax, jitter);
+	frames++;
+}
+
+//each sleep's overshoot feeds the estimate, so the spin is as short as this host's timer allows
+void FramePacer::SleepUntil(Clock::time_point deadline) {
+	Clock::time_point now = Clock::now();
+	while (std::chrono::duration<double>(deadline - now).count() > sleepMean + PACER_SLEEP_DEVIATIONS * sleepDeviation) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		Clock::time_point woke = Clock::now();
+
+		double slept = std::chrono::duration<double>(woke - now).count();
+		sleepSeconds += slept;
+		double error = slept - sleepMean;
+		sleepMean += error / 16;
+		sleepDeviation += (std::abs(error) - sleepDeviation) / 16;
+		now = woke;
+	}
+
+	Clock::time_point spinStart = now;
+	while (now < deadline) {
+		std::this_thread::yield();
+		now = Clock::now();
+	}
+	spinSeconds += std::chrono::duration<double>(now - spinStart).count();
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include <chrono>
+
+#include "CPU.h"
+
+//sleeps end this much after they were asked to on a quiet machine, until the pacer has measured its own
+#define PACER_INITIAL_SLEEP_MICROSECONDS 1000
+//the rest of the wait is spun once it is within this many deviations of a measured sleep
+#define PACER_SLEEP_DEVIATIONS 2
+//further behind than this the missed frames are dropped instead of run back to back
+#define PACER_MAX_LAG_FRAMES 4
+
+//holds a thread to one emulated frame per 60 Hz tick of the wall clock, times a speed multiplier
+//frames are due at absolute times counted from the start, so an early or late wake doesn't push the ones after it
+//the wait sleeps in short steps while the deadline is further off than a sleep has been seen to overshoot, then spins the rest
+class FramePacer {
+public:
+	FramePacer(double speed = 1.0);
+	~FramePacer();
+
+	//the first frame is due one period after this
+	void Start();
+	//returns when the next frame is due
+	void Wait();
+
+	double GetSpeed() const { return speed; }
+	uint64_t GetFrames() const { return frames; }
+	//how late Wait returned, in microseconds
+	double GetMeanJitter() const { return frames ? jitterTotal / frames : 0.0; }
+	double GetMaxJitter() const { return jitterMax; }
+	//times the pacer fell more than PACER_MAX_LAG_FRAMES behind and started counting again from the time it noticed
+	uint64_t GetResyncs() const { return resyncs; }
+	double GetSleepSeconds() const { return sleepSeconds; }
+	double GetSpinSeconds() const { return spinSeconds; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	double speed;
+	Clock::duration period;
+	Clock::time_point start;
+	uint64_t frames = 0;
+	uint64_t frameIndex = 0;
+	double jitterTotal = 0;
+	double jitterMax = 0;
+	uint64_t resyncs = 0;
+	double sleepSeconds = 0;
+	double spinSeconds = 0;
+	//running mean and mean deviation of how long a 1 ms sleep really takes, in seconds
+	double sleepMean = PACER_INITIAL_SLEEP_MICROSECONDS / 1000000.0;
+	double sleepDeviation = 0;
+
+	void SleepUntil(Clock::time_point deadline);
+};
@@ -0,0 +1,32 @@
+#include "FrameSkip.h"
+#include <algorithm>
+
+FrameSkip::FrameSkip(size_t fastForward, bool adaptive) : fastForward(std::max<size_t>(fastForward, 1)), adaptive(adaptive) {
+}
+
+//frames owed are counted from the first call, so time spent before the first present isn't caught up
+size_t FrameSkip::NextFrames(std::chrono::steady_clock::time_point now) {
+	framesPresented++;
+	if (!adaptive) {
+		framesRun += fastForward;
+		return fastForward;
+	}
+
+	if (!started) {
+		start = now;
+		started = true;
+	}
+
+	double elapsed = std::chrono::duration<double>(now - start).count();
+	uint64_t target = static_cast<uint64_t>(elapsed * CLOCK_RATE / FRAME_CYCLES * fastForward) + 1;
+	uint64_t owed = target > framesRun + framesLost ? target - framesRun - framesLost : 0;
+
+	uint64_t limit = MAX_FRAME_SKIP * fastForward;
+	if (owed > limit) {
+		framesLost += owed - limit;
+		owed = limit;
+	}
+
+	framesRun += owed;
+	return static_cast<size_t>(owed);
+}
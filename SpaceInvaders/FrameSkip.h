@@ -0,0 +1,37 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+
+#include "CPU.h"
+
+//most frames run for one presented, beyond it a slow host slows the game down rather than showing a slideshow
+#define MAX_FRAME_SKIP 8
+
+//how many emulated frames to run before each presented one
+//frames that are run but never presented skip ConvertImage and the upload, their rows stay dirty until one is shown
+class FrameSkip {
+public:
+	//fastForward runs that many frames per present, adaptive paces them by the wall clock at fastForward times real time
+	//so a host that can't present every frame drops presentation instead of slowing the game
+	FrameSkip(size_t fastForward = 1, bool adaptive = false);
+
+	//frames to run before the next present, asked once per present, adaptive can return 0 when presenting faster than 60 Hz
+	size_t NextFrames(std::chrono::steady_clock::time_point now);
+
+	size_t GetFastForward() const { return fastForward; }
+	bool IsAdaptive() const { return adaptive; }
+	uint64_t GetFramesRun() const { return framesRun; }
+	uint64_t GetFramesPresented() const { return framesPresented; }
+	//frames the adaptive mode gave up on because even MAX_FRAME_SKIP couldn't catch up
+	uint64_t GetFramesLost() const { return framesLost; }
+
+private:
+	size_t fastForward;
+	bool adaptive;
+	bool started = false;
+	std::chrono::steady_clock::time_point start;
+	uint64_t framesRun = 0;
+	uint64_t framesPresented = 0;
+	uint64_t framesLost = 0;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "CPU.h"
+
+//the input script repeats every 40 seconds of emulated time, long enough for a game to end
+#define SCRIPT_FRAMES 2400
+
+//player 1 input for a frame: insert a coin and start, then sweep left and right while tapping fire
+inline uint8_t ScriptedInput(size_t frame) {
+	size_t time = frame % SCRIPT_FRAMES;
+	uint8_t input = INPUT_ALWAYS_ON;
+
+	if (time >= 60 && time < 70) {
+		input |= INPUT_COIN;
+	} else if (time >= 120 && time < 130) {
+		input |= INPUT_P1_START;
+	} else if (time >= 200) {
+		input |= (time / 30) % 2 ? INPUT_P1_LEFT : INPUT_P1_RIGHT;
+		if ((time / 8) % 2) input |= INPUT_P1_FIRE;
+	}
+
+	return input;
+}
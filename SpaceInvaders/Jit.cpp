@@ -0,0 +1,929 @@
+#include "Jit.h"
+
+#if CPU_JIT_SUPPORTED
+
+#include <stddef.h>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/mman.h>
+
+#include "CPU.h"
+#include "Flags.h"
+#include "Opcodes.h"
+
+//the 8080 registers live in host registers while translated code runs, and are spilled to State around calls
+#define REG_A R8
+#define REG_B R9
+#define REG_C R10
+#define REG_D R11
+#define REG_E R12
+#define REG_H R13
+#define REG_L RSI
+#define REG_SP RDI
+
+#define REG_CONTEXT RBX
+#define REG_CPU RBP
+#define REG_STATE R14
+#define REG_PAGES R15
+
+//which 8080 flags the host EFLAGS still hold after an instruction
+#define HOST_Z 1
+#define HOST_S 2
+#define HOST_P 4
+#define HOST_CY 8
+
+#define STATE_FIELD(field) Mem{ REG_STATE, NO_REG, static_cast<int32_t>(offsetof(State, field)) }
+#define STATE_F STATE_FIELD(psw.bytes.low)
+#define CONTEXT_FIELD(field) Mem{ REG_CONTEXT, NO_REG, static_cast<int32_t>(offsetof(JitContext, field)) }
+
+//indexed by the register field of an opcode, 6 is M
+static const Reg hostRegs[8] = { REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, NO_REG, REG_A };
+static const size_t stateOffsets[8] = {
+	offsetof(State, bc.bytes.high), offsetof(State, bc.bytes.low), offsetof(State, de.bytes.high), offsetof(State, de.bytes.low),
+	offsetof(State, hl.bytes.high), offsetof(State, hl.bytes.low), 0, offsetof(State, psw.bytes.high)
+};
+
+//high and low halves of BC, DE and HL
+static const Reg pairHigh[3] = { REG_B, REG_D, REG_H };
+static const Reg pairLow[3] = { REG_C, REG_E, REG_L };
+
+//the bus entry for the page number in index, REG_PAGES points at the read table
+static Mem ReadPage(Reg index) {
+	return { REG_PAGES, index, 0, 3 };
+}
+
+//the write table sits at a fixed distance from the read table
+static Mem WritePage(const MemoryBus& bus, Reg index) {
+	const uint8_t* reads = reinterpret_cast<const uint8_t*>(bus.GetReadPages());
+	const uint8_t* writes = reinterpret_cast<const uint8_t*>(bus.GetWritePages());
+	return { REG_PAGES, index, static_cast<int32_t>(writes - reads), 3 };
+}
+
+//the bus's marks for the page number in index
+static Mem MarkPage(const MemoryBus& bus, Reg index) {
+	const uint8_t* reads = reinterpret_cast<const uint8_t*>(bus.GetReadPages());
+	const uint8_t* marks = reinterpret_cast<const uint8_t*>(bus.GetMarkPages());
+	return { REG_PAGES, index, static_cast<int32_t>(marks - reads), 3 };
+}
+
+//where EmitStoreRegisters leaves a host register
+static Mem SpilledRegister(Reg reg) {
+	for (int i = 0; i < 8; i++) {
+		if (i != 6 && hostRegs[i] == reg) return Mem{ REG_STATE, NO_REG, static_cast<int32_t>(stateOffsets[i]) };
+	}
+	return STATE_FIELD(sp);
+}
+
+Jit::Jit(CPU& cpu) : cpu(cpu), emitter(nullptr), blocks(0x10000, nullptr), codePages(PAGE_COUNT, nullptr) {
+	void* memory = mmap(nullptr, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED) {
+		throw std::runtime_error("Could not map JIT arena");
+	}
+	arena = static_cast<uint8_t*>(memory);
+
+	emitter.SetPosition(arena);
+	EmitTrampoline();
+	arenaStart = emitter.Position();
+
+	context = {};
+}
+
+Jit::~Jit() {
+	//hand the hooked pages back to the bus
+	Flush();
+	munmap(arena, JIT_ARENA_SIZE);
+}
+
+void Jit::Flush() {
+	std::fill(blocks.begin(), blocks.end(), nullptr);
+	for (uint32_t page = 0; page < PAGE_COUNT; page++) {
+		if (!codePages[page]) continue;
+		cpu.bus.MapWrite(static_cast<uint16_t>(page << PAGE_SHIFT), PAGE_SIZE, codePages[page]);
+		codePages[page] = nullptr;
+	}
+	pendingLinks.clear();
+	emitter.SetPosition(arenaStart);
+}
+
+//the counters are handed over through the context, whole blocks run only while they fit before the target
+void Jit::Run(uint64_t target) {
+	State& state = cpu.state;
+
+	while (cpu.cycleCount < target) {
+		uint8_t* block = blocks[state.pc];
+		if (!block) {
+			block = Compile(state.pc);
+		}
+		if (!block) {
+			cpu.Dispatch(cpu.cycleCount + 1);
+			continue;
+		}
+
+		//helper calls also write cpu.cycleCount, so compare against the count from before entering
+		uint64_t start = cpu.cycleCount;
+		context.cycleCount = start;
+		context.target = target;
+		context.instructionCount = cpu.instructionCount;
+		context.flushed = 0;
+		enter(&context, &state, &cpu, cpu.bus.GetReadPages(), block);
+
+		bool progress = context.cycleCount != start;
+		cpu.cycleCount = context.cycleCount;
+		cpu.instructionCount = context.instructionCount;
+
+		//the next block would cross the target, so step the rest in the interpreter
+		if (!progress) {
+			cpu.Dispatch(target);
+		}
+	}
+}
+
+//opcodes the interpreter doesn't implement either
+bool Jit::Translatable(uint8_t opcode) {
+	switch (opcode) {
+		case 0x10: case 0x18: case 0x28: case 0x30: case 0x38:
+		case 0x76: case 0xCB: case 0xD9: case 0xDD: case 0xED:
+		case 0xF9: case 0xFD:
+			return false;
+		default:
+			return true;
+	}
+}
+
+void Jit::ExecuteHelper(CPU* cpu, JitContext* context, uint32_t instruction) {
+	cpu->cycleCount = context->cycleCount;
+	cpu->Interpret(static_cast<uint8_t>(instruction), static_cast<uint16_t>(instruction >> 8));
+	context->cycleCount = cpu->cycleCount;
+}
+
+uint8_t Jit::ReadHelper(CPU* cpu, uint32_t address) {
+	return cpu->bus.Read(static_cast<uint16_t>(address));
+}
+
+void Jit::WriteHelper(CPU* cpu, uint32_t address, uint32_t value) {
+	cpu->bus.Write(static_cast<uint16_t>(address), static_cast<uint8_t>(value));
+}
+
+//stores to a page holding translated code land here, translated code checks flushed after every store that can
+void Jit::CodeWriteHandler(void* context, uint16_t address, uint8_t value) {
+	Jit* jit = static_cast<Jit*>(context);
+	jit->codePages[address >> PAGE_SHIFT][address & (PAGE_SIZE - 1)] = value;
+	jit->cpu.bus.Mark(address);
+	jit->Flush();
+	jit->context.flushed = 1;
+}
+
+//route stores to a RAM page holding translated code, and to every mirror of it, through CodeWriteHandler
+void Jit::ProtectPage(uint16_t page) {
+	uint16_t address = static_cast<uint16_t>(page << PAGE_SHIFT);
+	uint8_t* target = cpu.bus.GetWritePointer(address);
+	//ROM, or hooked already
+	if (!target || target != cpu.bus.GetReadPointer(address)) return;
+
+	for (uint32_t other = 0; other < PAGE_COUNT; other++) {
+		uint16_t base = static_cast<uint16_t>(other << PAGE_SHIFT);
+		if (cpu.bus.GetWritePointer(base) != target) continue;
+		codePages[other] = target;
+		cpu.bus.MapWriteHandler(base, PAGE_SIZE, &CodeWriteHandler, this);
+	}
+}
+
+//enter(context, state, cpu, pages, block) saves the callee-saved registers, loads the 8080 registers and jumps to the block
+void Jit::EmitTrampoline() {
+	enter = reinterpret_cast<Entry>(emitter.Position());
+	emitter.Push(RBX);
+	emitter.Push(RBP);
+	emitter.Push(R12);
+	emitter.Push(R13);
+	emitter.Push(R14);
+	emitter.Push(R15);
+	//realign the stack to 16 bytes for the helper calls
+	emitter.Alu64RI(ALU_SUB, RSP, 8);
+	emitter.MovRR64(REG_CONTEXT, RDI);
+	emitter.MovRR64(REG_STATE, RSI);
+	emitter.MovRR64(REG_CPU, RDX);
+	emitter.MovRR64(REG_PAGES, RCX);
+	emitter.MovRR64(RAX, R8);
+	EmitLoadRegisters();
+	emitter.JmpR(RAX);
+
+	exitStore = emitter.Position();
+	EmitStoreRegisters();
+	exitNoStore = emitter.Position();
+	emitter.Alu64RI(ALU_ADD, RSP, 8);
+	emitter.Pop(R15);
+	emitter.Pop(R14);
+	emitter.Pop(R13);
+	emitter.Pop(R12);
+	emitter.Pop(RBP);
+	emitter.Pop(RBX);
+	emitter.Ret();
+}
+
+void Jit::EmitLoadRegisters() {
+	for (int i = 0; i < 8; i++) {
+		if (i == 6) continue;
+		emitter.LoadZX8(hostRegs[i], Mem{ REG_STATE, NO_REG, static_cast<int32_t>(stateOffsets[i]) });
+	}
+	emitter.LoadZX16(REG_SP, STATE_FIELD(sp));
+}
+
+void Jit::EmitStoreRegisters() {
+	for (int i = 0; i < 8; i++) {
+		if (i == 6) continue;
+		emitter.Store8(Mem{ REG_STATE, NO_REG, static_cast<int32_t>(stateOffsets[i]) }, hostRegs[i]);
+	}
+	emitter.Store16(STATE_FIELD(sp), REG_SP);
+}
+
+uint8_t* Jit::Compile(uint16_t pc) {
+	struct Instruction {
+		uint16_t pc;
+		uint8_t opcode;
+		uint16_t operand;
+		//flags that something reads after this instruction, before the block overwrites them
+		uint8_t liveFlags;
+	};
+
+	if (arena + JIT_ARENA_SIZE - emitter.Position() < JIT_BLOCK_RESERVE) {
+		Flush();
+	}
+
+	const MemoryBus& bus = cpu.bus;
+	Instruction instructions[MAX_BLOCK_LENGTH];
+	uint32_t count = 0;
+	uint32_t cycles = 0;
+	uint32_t address = pc;
+
+	while (count < MAX_BLOCK_LENGTH) {
+		uint8_t opcode = bus.Read(static_cast<uint16_t>(address));
+		uint8_t length = lengthTable.entries[opcode];
+		if (!Translatable(opcode) || address + length > 0x10000) break;
+
+		Instruction& inst = instructions[count++];
+		inst.pc = static_cast<uint16_t>(address);
+		inst.opcode = opcode;
+		inst.operand = 0;
+		if (length > 1) inst.operand = bus.Read(static_cast<uint16_t>(address + 1));
+		if (length > 2) inst.operand |= bus.Read(static_cast<uint16_t>(address + 2)) << 8;
+
+		cycles += cycleTable.entries[opcode];
+		address += length;
+
+		if (opcodeTable.entries[opcode].endsBlock) break;
+	}
+
+	if (count == 0) return nullptr;
+
+	//everything is live where the block can be left, at its end and after any store that may hit translated code
+	uint8_t live = FLAG_MASK;
+	for (uint32_t i = count; i-- > 0;) {
+		const OpcodeInfo& info = opcodeTable.entries[instructions[i].opcode];
+		if (info.memory == MEMORY_WRITE || info.memory == MEMORY_MODIFY || info.memory == MEMORY_STACK) {
+			live = FLAG_MASK;
+		}
+		instructions[i].liveFlags = live;
+		live = static_cast<uint8_t>((live & ~info.flagsWritten) | info.flagsRead);
+	}
+
+	for (uint32_t page = pc >> PAGE_SHIFT; page <= (address - 1) >> PAGE_SHIFT; page++) {
+		ProtectPage(static_cast<uint16_t>(page));
+	}
+
+	uint8_t* entry = emitter.Position();
+	links.clear();
+	invalidations.clear();
+	slowAccesses.clear();
+
+	emitter.Load64(RAX, CONTEXT_FIELD(cycleCount));
+	emitter.Alu64RI(ALU_ADD, RAX, cycles);
+	emitter.Alu64RM(ALU_CMP, RAX, CONTEXT_FIELD(target));
+	uint8_t* bail = emitter.Jcc(COND_A);
+	emitter.Store64(CONTEXT_FIELD(cycleCount), RAX);
+	emitter.Alu64MI(ALU_ADD, CONTEXT_FIELD(instructionCount), count);
+
+	hostFlags = 0;
+	remainingCycles = cycles;
+	remainingInstructions = count;
+	for (uint32_t i = 0; i < count; i++) {
+		const Instruction& inst = instructions[i];
+		remainingCycles -= cycleTable.entries[inst.opcode];
+		remainingInstructions--;
+		nextPC = static_cast<uint16_t>(inst.pc + lengthTable.entries[inst.opcode]);
+		liveFlags = inst.liveFlags;
+		EmitInstruction(inst.pc, inst.opcode, inst.operand);
+	}
+
+	//cut short by the length limit or an opcode that can't be translated
+	if (!opcodeTable.entries[instructions[count - 1].opcode].endsBlock) {
+		EmitExit(nextPC);
+	}
+
+	//everything below is out of line
+	Emitter::Link(bail, emitter.Position());
+	emitter.Store16I(STATE_FIELD(pc), pc);
+	emitter.JmpTo(exitStore);
+
+	//the store stubs add to invalidations
+	for (const SlowAccess& access : slowAccesses) {
+		if (access.count) EmitSlowStore(access);
+		else EmitSlowLoad(access);
+	}
+
+	for (const Invalidation& invalidation : invalidations) {
+		Emitter::Link(invalidation.field, emitter.Position());
+		emitter.Store16I(STATE_FIELD(pc), invalidation.resume);
+		emitter.Alu64MI(ALU_SUB, CONTEXT_FIELD(cycleCount), invalidation.cycles);
+		emitter.Alu64MI(ALU_SUB, CONTEXT_FIELD(instructionCount), invalidation.instructions);
+		emitter.JmpTo(exitNoStore);
+	}
+
+	for (const Link& link : links) {
+		if (blocks[link.target]) {
+			Emitter::Link(link.field, blocks[link.target]);
+			continue;
+		}
+
+		Emitter::Link(link.field, emitter.Position());
+		emitter.Store16I(STATE_FIELD(pc), link.target);
+		emitter.JmpTo(exitStore);
+		pendingLinks[link.target].push_back(link.field);
+	}
+
+	//chain the exits that were waiting for this block
+	blocks[pc] = entry;
+	auto pending = pendingLinks.find(pc);
+	if (pending != pendingLinks.end()) {
+		for (uint8_t* field : pending->second) {
+			Emitter::Link(field, entry);
+		}
+		pendingLinks.erase(pending);
+	}
+
+	return entry;
+}
+
+void Jit::EmitInstruction(uint16_t pc, uint8_t opcode, uint16_t operand) {
+	uint8_t flags = hostFlags;
+	hostFlags = 0;
+
+	uint8_t dst = (opcode >> 3) & 0x7;
+	uint8_t src = opcode & 0x7;
+	uint8_t pair = (opcode >> 4) & 0x3;
+
+	//MOV, 0x76 is HLT
+	if (opcode >= 0x40 && opcode < 0x80 && opcode != 0x76) {
+		if (dst == 6) {
+			EmitAddressHL();
+			EmitStore(hostRegs[src]);
+		} else if (src == 6) {
+			EmitAddressHL();
+			EmitLoad(hostRegs[dst]);
+		} else if (dst != src) {
+			emitter.MovRR32(hostRegs[dst], hostRegs[src]);
+		}
+		return;
+	}
+
+	//ADD, ADC, SUB, SBB, ANA, XRA, ORA and CMP
+	if (opcode >= 0x80 && opcode < 0xC0) {
+		Reg source = hostRegs[src];
+		if (src == 6) {
+			EmitAddressHL();
+			EmitLoad(RCX);
+			source = RCX;
+		}
+		EmitArithmetic(dst, source, false, 0);
+		return;
+	}
+
+	//immediate forms, ADI through CPI
+	if ((opcode & 0xC7) == 0xC6) {
+		EmitArithmetic(dst, NO_REG, true, static_cast<uint8_t>(operand));
+		return;
+	}
+
+	if ((opcode & 0xC7) == 0x04 || (opcode & 0xC7) == 0x05) {
+		EmitIncDec(dst, opcode & 1);
+		return;
+	}
+
+	if ((opcode & 0xC7) == 0x06) {	//MVI
+		if (dst == 6) {
+			EmitAddressHL();
+			EmitStore(NO_REG, static_cast<uint8_t>(operand));
+		} else {
+			emitter.MovRI32(hostRegs[dst], operand & 0xFF);
+		}
+		return;
+	}
+
+	if ((opcode & 0xC7) == 0xC2) {	//Jcc
+		EmitExitIf(EmitCondition(dst, flags), operand);
+		EmitExit(nextPC);
+		return;
+	}
+
+	//Ccc and Rcc, the block only paid for the untaken case
+	if ((opcode & 0xC7) == 0xC4 || (opcode & 0xC7) == 0xC0) {
+		Cond taken = EmitCondition(dst, flags);
+		uint8_t* skip = emitter.Jcc(static_cast<Cond>(taken ^ 1));
+		emitter.Alu64MI(ALU_ADD, CONTEXT_FIELD(cycleCount), opcodeTable.entries[opcode].takenCycles);
+		if (opcode & 0x4) EmitCall(operand);
+		else EmitReturn();
+		Emitter::Link(skip, emitter.Position());
+		EmitExit(nextPC);
+		return;
+	}
+
+	switch (opcode) {
+		case 0x00:	//NOP
+		case 0x08:
+		case 0x20:
+			break;
+		case 0x01:	//LXI
+		case 0x11:
+		case 0x21:
+			emitter.MovRI32(pairHigh[pair], operand >> 8);
+			emitter.MovRI32(pairLow[pair], operand & 0xFF);
+			break;
+		case 0x31:	//LXI SP
+			emitter.MovRI32(REG_SP, operand);
+			break;
+		case 0x02:	//STAX
+		case 0x12:
+			EmitPair(pair, RCX);
+			EmitStore(REG_A);
+			break;
+		case 0x0A:	//LDAX
+		case 0x1A:
+			EmitPair(pair, RCX);
+			EmitLoad(REG_A);
+			break;
+		case 0x03:	//INX
+		case 0x13:
+		case 0x23:
+		case 0x33:
+		case 0x0B:	//DCX
+		case 0x1B:
+		case 0x2B:
+		case 0x3B:
+			EmitPair(pair, RCX);
+			emitter.Alu32RI(opcode & 0x8 ? ALU_SUB : ALU_ADD, RCX, 1);
+			emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+			EmitSetPair(pair, RCX);
+			break;
+		case 0x09:	//DAD
+		case 0x19:
+		case 0x29:
+		case 0x39:
+			EmitPair(2, RCX);
+			EmitPair(pair, RDX);
+			emitter.Alu32RR(ALU_ADD, RCX, RDX);
+			emitter.Bt32(RCX, 16);
+			EmitCarry();
+			emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+			EmitSetPair(2, RCX);
+			break;
+		case 0x07:	//RLC
+		case 0x0F:	//RRC
+		case 0x17:	//RAL
+		case 0x1F:	//RAR
+		{
+			static const ShiftOp rotates[4] = { SHIFT_ROL, SHIFT_ROR, SHIFT_RCL, SHIFT_RCR };
+			if (opcode & 0x10) {
+				emitter.LoadZX8(RDX, STATE_F);
+				emitter.Bt32(RDX, 0);
+			}
+			emitter.MovRR32(RAX, REG_A);
+			emitter.Shift8(rotates[dst], RAX);
+			emitter.MovZX8(REG_A, RAX);
+			EmitCarry();
+			break;
+		}
+		case 0x22:	//SHLD
+			emitter.MovRI32(RCX, operand);
+			EmitStoreWord(REG_L, REG_H);
+			break;
+		case 0x2A:	//LHLD
+			emitter.MovRI32(RCX, operand);
+			EmitLoad(REG_L);
+			emitter.Alu32RI(ALU_ADD, RCX, 1);
+			emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+			EmitLoad(REG_H);
+			break;
+		case 0x2F:	//CMA
+			emitter.Alu32RI(ALU_XOR, REG_A, 0xFF);
+			break;
+		case 0x32:	//STA
+			emitter.MovRI32(RCX, operand);
+			EmitStore(REG_A);
+			break;
+		case 0x3A:	//LDA
+			emitter.MovRI32(RCX, operand);
+			EmitLoad(REG_A);
+			break;
+		case 0x37:	//STC
+			emitter.Alu8MI(ALU_OR, STATE_F, FLAG_CY);
+			break;
+		case 0x3F:	//CMC
+			emitter.Alu8MI(ALU_XOR, STATE_F, FLAG_CY);
+			break;
+		case 0xC1:	//POP
+		case 0xD1:
+		case 0xE1:
+			emitter.MovRR32(RCX, REG_SP);
+			EmitLoad(pairLow[pair]);
+			emitter.Alu32RI(ALU_ADD, RCX, 1);
+			emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+			EmitLoad(pairHigh[pair]);
+			emitter.Alu32RI(ALU_ADD, REG_SP, 2);
+			emitter.Alu32RI(ALU_AND, REG_SP, 0xFFFF);
+			break;
+		case 0xC5:	//PUSH
+		case 0xD5:
+		case 0xE5:
+			emitter.Alu32RI(ALU_SUB, REG_SP, 2);
+			emitter.Alu32RI(ALU_AND, REG_SP, 0xFFFF);
+			emitter.MovRR32(RCX, REG_SP);
+			EmitStoreWord(pairLow[pair], pairHigh[pair]);
+			break;
+		case 0xC3:	//JMP
+			EmitExit(operand);
+			break;
+		case 0xCD:	//CALL
+			EmitCall(operand);
+			break;
+		case 0xC9:	//RET
+			EmitReturn();
+			break;
+		case 0xE9:	//PCHL
+			EmitAddressHL();
+			emitter.Store16(STATE_FIELD(pc), RCX);
+			EmitIndirectExit();
+			break;
+		case 0xEB:	//XCHG
+			emitter.XchgRR32(REG_D, REG_H);
+			emitter.XchgRR32(REG_E, REG_L);
+			break;
+		default:
+			EmitHelper(pc, opcode, operand, opcodeTable.entries[opcode].endsBlock);
+			break;
+	}
+}
+
+//jumps to the target block once it is translated, until then to a stub that leaves with pc set
+void Jit::EmitExit(uint16_t target) {
+	links.push_back({ emitter.Jmp(), target });
+}
+
+void Jit::EmitExitIf(Cond cond, uint16_t target) {
+	links.push_back({ emitter.Jcc(cond), target });
+}
+
+//pushes the address after the instruction, a store that flushes translated code leaves the block at the callee
+void Jit::EmitCall(uint16_t target) {
+	uint16_t returnPC = nextPC;
+	emitter.Alu32RI(ALU_SUB, REG_SP, 2);
+	emitter.Alu32RI(ALU_AND, REG_SP, 0xFFFF);
+	emitter.MovRR32(RCX, REG_SP);
+	nextPC = target;
+	EmitStoreWord(NO_REG, NO_REG, returnPC);
+	nextPC = returnPC;
+	EmitExit(target);
+}
+
+//pops straight into state.pc, which is where an exit leaves it anyway
+void Jit::EmitReturn() {
+	const int32_t pcOffset = static_cast<int32_t>(offsetof(State, pc));
+	emitter.MovRR32(RCX, REG_SP);
+	EmitLoad(RDX);
+	emitter.Store8(Mem{ REG_STATE, NO_REG, pcOffset }, RDX);
+	emitter.Alu32RI(ALU_ADD, RCX, 1);
+	emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+	EmitLoad(RDX);
+	emitter.Store8(Mem{ REG_STATE, NO_REG, pcOffset + 1 }, RDX);
+	emitter.Alu32RI(ALU_ADD, REG_SP, 2);
+	emitter.Alu32RI(ALU_AND, REG_SP, 0xFFFF);
+	EmitIndirectExit();
+}
+
+//jumps to the block for state.pc when it is translated, otherwise leaves with pc already set
+void Jit::EmitIndirectExit() {
+	emitter.LoadZX16(RCX, STATE_FIELD(pc));
+	emitter.MovRI64(RAX, reinterpret_cast<uint64_t>(blocks.data()));
+	emitter.Load64(RAX, Mem{ RAX, RCX, 0, 3 });
+	emitter.Test64(RAX, RAX);
+	Emitter::Link(emitter.Jcc(COND_E), exitStore);
+	emitter.JmpR(RAX);
+}
+
+//everything else runs through the interpreter, with the registers spilled
+void Jit::EmitHelper(uint16_t pc, uint8_t opcode, uint16_t operand, bool leavesBlock) {
+	EmitStoreRegisters();
+	emitter.Store16I(STATE_FIELD(pc), static_cast<uint16_t>(pc + 1));
+	emitter.MovRR64(RDI, REG_CPU);
+	emitter.MovRR64(RSI, REG_CONTEXT);
+	emitter.MovRI32(RDX, opcode | (operand << 8));
+	emitter.Call(reinterpret_cast<const void*>(&ExecuteHelper));
+
+	if (leavesBlock) {
+		emitter.JmpTo(exitNoStore);
+		return;
+	}
+
+	//the instruction wrote over translated code, pc already points past it
+	emitter.Alu8MI(ALU_CMP, CONTEXT_FIELD(flushed), 0);
+	invalidations.push_back({ emitter.Jcc(COND_NE), nextPC, remainingCycles, remainingInstructions });
+	EmitLoadRegisters();
+}
+
+//0 BC, 1 DE, 2 HL, 3 SP
+void Jit::EmitPair(uint8_t pair, Reg dst) {
+	if (pair == 3) {
+		emitter.MovRR32(dst, REG_SP);
+		return;
+	}
+
+	emitter.MovRR32(dst, pairHigh[pair]);
+	emitter.Shift32RI(SHIFT_SHL, dst, 8);
+	emitter.Alu32RR(ALU_OR, dst, pairLow[pair]);
+}
+
+void Jit::EmitSetPair(uint8_t pair, Reg src) {
+	if (pair == 3) {
+		emitter.MovRR32(REG_SP, src);
+		return;
+	}
+
+	emitter.MovZX8(pairLow[pair], src);
+	emitter.MovRR32(pairHigh[pair], src);
+	emitter.Shift32RI(SHIFT_SHR, pairHigh[pair], 8);
+}
+
+void Jit::EmitAddressHL() {
+	EmitPair(2, RCX);
+}
+
+//loads the byte at the address in RCX into dst straight from a direct page, RAX is scratch
+void Jit::EmitLoad(Reg dst) {
+	emitter.MovRR32(RAX, RCX);
+	emitter.Shift32RI(SHIFT_SHR, RAX, PAGE_SHIFT);
+	emitter.Load64(RAX, ReadPage(RAX));
+	emitter.Test64(RAX, RAX);
+	uint8_t* slow = emitter.Jcc(COND_E);
+	emitter.LoadZX8(dst, Mem{ RAX, RCX, 0 });
+	slowAccesses.push_back({ { slow, nullptr }, emitter.Position(), { dst, NO_REG }, {}, 0, {} });
+}
+
+//stores value, or the immediate when that is NO_REG, to the address in RCX, RDX is scratch
+void Jit::EmitStore(Reg value, uint8_t immediate) {
+	emitter.MovRR32(RDX, RCX);
+	emitter.Shift32RI(SHIFT_SHR, RDX, PAGE_SHIFT);
+	emitter.Load64(RDX, WritePage(cpu.bus, RDX));
+	emitter.Test64(RDX, RDX);
+	uint8_t* slow = emitter.Jcc(COND_E);
+	if (value == NO_REG) emitter.Store8I(Mem{ RDX, RCX, 0 }, immediate);
+	else emitter.Store8(Mem{ RDX, RCX, 0 }, value);
+	EmitMark();
+	slowAccesses.push_back({ { slow, nullptr }, emitter.Position(), { value, NO_REG }, { immediate, 0 }, 1,
+		{ nullptr, nextPC, remainingCycles, remainingInstructions } });
+}
+
+//stores low to the address in RCX and high after it, the bus takes both bytes unless both pages are direct
+//either half comes from the immediate when its register is NO_REG, RAX and RDX are scratch and RCX is left past the low byte
+void Jit::EmitStoreWord(Reg low, Reg high, uint16_t immediate) {
+	emitter.MovRR32(RDX, RCX);
+	emitter.Shift32RI(SHIFT_SHR, RDX, PAGE_SHIFT);
+	emitter.Load64(RDX, WritePage(cpu.bus, RDX));
+	emitter.Test64(RDX, RDX);
+	uint8_t* slowLow = emitter.Jcc(COND_E);
+	emitter.MovRR32(RAX, RCX);
+	emitter.Alu32RI(ALU_ADD, RAX, 1);
+	emitter.Alu32RI(ALU_AND, RAX, 0xFFFF);
+	emitter.Shift32RI(SHIFT_SHR, RAX, PAGE_SHIFT);
+	emitter.Load64(RAX, WritePage(cpu.bus, RAX));
+	emitter.Test64(RAX, RAX);
+	uint8_t* slowHigh = emitter.Jcc(COND_E);
+	if (low == NO_REG) emitter.Store8I(Mem{ RDX, RCX, 0 }, static_cast<uint8_t>(immediate));
+	else emitter.Store8(Mem{ RDX, RCX, 0 }, low);
+	emitter.Alu32RI(ALU_ADD, RCX, 1);
+	emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+	if (high == NO_REG) emitter.Store8I(Mem{ RAX, RCX, 0 }, static_cast<uint8_t>(immediate >> 8));
+	else emitter.Store8(Mem{ RAX, RCX, 0 }, high);
+	//the page bases are spent, so the marks come after both stores
+	EmitMark();
+	emitter.Alu32RI(ALU_SUB, RCX, 1);
+	emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+	EmitMark();
+	emitter.Alu32RI(ALU_ADD, RCX, 1);
+	emitter.Alu32RI(ALU_AND, RCX, 0xFFFF);
+	slowAccesses.push_back({ { slowLow, slowHigh }, emitter.Position(), { low, high }, { static_cast<uint8_t>(immediate), static_cast<uint8_t>(immediate >> 8) }, 2,
+		{ nullptr, nextPC, remainingCycles, remainingInstructions } });
+}
+
+//what MemoryBus::Write does after a direct store, for the address in RCX, RAX and RDX are scratch
+//the store has already used the value, so INR M and DCR M lose nothing when RAX is overwritten
+void Jit::EmitMark() {
+	emitter.MovRR32(RDX, RCX);
+	emitter.Shift32RI(SHIFT_SHR, RDX, PAGE_SHIFT);
+	emitter.Load64(RDX, MarkPage(cpu.bus, RDX));
+	emitter.Test64(RDX, RDX);
+	uint8_t* unmarked = emitter.Jcc(COND_E);
+	emitter.MovRR32(RAX, RCX);
+	emitter.Shift32RI(SHIFT_SHR, RAX, WRITE_MARK_SHIFT);
+	emitter.Store8I(Mem{ RDX, RAX, 0 }, 1);
+	Emitter::Link(unmarked, emitter.Position());
+}
+
+void Jit::EmitSlowLoad(const SlowAccess& access) {
+	Emitter::Link(access.fields[0], emitter.Position());
+	EmitStoreRegisters();
+	//keep RCX, and the stack aligned, across the call
+	emitter.Push(RCX);
+	emitter.Alu64RI(ALU_SUB, RSP, 8);
+	emitter.MovRR32(RSI, RCX);
+	emitter.MovRR64(RDI, REG_CPU);
+	emitter.Call(reinterpret_cast<const void*>(&ReadHelper));
+	emitter.Alu64RI(ALU_ADD, RSP, 8);
+	emitter.Pop(RCX);
+	EmitLoadRegisters();
+	emitter.MovZX8(access.values[0], RAX);
+	emitter.JmpTo(access.resume);
+}
+
+//a handler may flush the block it was called from, which then leaves after the instruction
+void Jit::EmitSlowStore(const SlowAccess& access) {
+	for (uint8_t* field : access.fields) {
+		if (field) Emitter::Link(field, emitter.Position());
+	}
+	EmitStoreRegisters();
+	emitter.Push(RCX);
+	emitter.Alu64RI(ALU_SUB, RSP, 8);
+	for (uint8_t i = 0; i < access.count; i++) {
+		//RAX only holds a value until the first call, and only INR M and DCR M store from it
+		Reg value = access.values[i];
+		if (value == NO_REG) emitter.MovRI32(RDX, access.immediates[i]);
+		else if (value == RAX) emitter.MovRR32(RDX, RAX);
+		else emitter.LoadZX8(RDX, SpilledRegister(value));
+		emitter.LoadZX16(RSI, Mem{ RSP, NO_REG, 8 });
+		if (i) {
+			emitter.Alu32RI(ALU_ADD, RSI, i);
+			emitter.Alu32RI(ALU_AND, RSI, 0xFFFF);
+		}
+		emitter.MovRR64(RDI, REG_CPU);
+		emitter.Call(reinterpret_cast<const void*>(&WriteHelper));
+	}
+	emitter.Alu64RI(ALU_ADD, RSP, 8);
+	emitter.Pop(RCX);
+
+	Invalidation invalidation = access.invalidation;
+	emitter.Alu8MI(ALU_CMP, CONTEXT_FIELD(flushed), 0);
+	invalidation.field = emitter.Jcc(COND_NE);
+	invalidations.push_back(invalidation);
+
+	EmitLoadRegisters();
+	emitter.JmpTo(access.resume);
+}
+
+//copy the host CF into CY, leaving the rest of F alone, RAX and RDX are scratch
+void Jit::EmitCarry() {
+	emitter.SetR(COND_B, RDX);
+	emitter.LoadZX8(RAX, STATE_F);
+	emitter.Alu32RI(ALU_AND, RAX, static_cast<uint8_t>(~FLAG_CY));
+	emitter.Alu32RR(ALU_OR, RAX, RDX);
+	emitter.Store8(STATE_F, RAX);
+}
+
+//LAHF leaves SF, ZF, AF, PF and CF in AH at the same bit positions the 8080 uses in F, so F is written whole
+//flip inverts AC where the 8080 disagrees with the host and aux replaces it
+//SAHF undoes whatever the fix-ups did to EFLAGS, so a following Jcc can still branch on them
+void Jit::EmitFlagResult(uint8_t flip, Reg aux) {
+	Reg flags = aux == RDX ? RCX : RDX;
+	emitter.Lahf();
+	emitter.MovZXAH(flags);
+	if (flip) emitter.Alu32RI(ALU_XOR, flags, flip);
+	if (aux != NO_REG) {
+		emitter.Alu32RI(ALU_AND, flags, static_cast<uint8_t>(~FLAG_AC));
+		emitter.Alu32RR(ALU_OR, flags, aux);
+	}
+	emitter.Store8(STATE_F, flags);
+	emitter.Store8I(STATE_FIELD(lazyFlags.pending), 0);
+	if (flip || aux != NO_REG) emitter.Sahf();
+}
+
+//INR and DCR keep CY, so rather than merging into F they store the lazy result for the 8-bit value in AL
+//none of these instructions touch EFLAGS either
+void Jit::EmitLazyResult(Reg result, bool decrement) {
+	emitter.Lahf();
+	emitter.MovZXAH(RDX);
+	//DCR adds the complement, so AC is the inverted borrow
+	if (decrement) emitter.Not32(RDX);
+	emitter.Store8(STATE_FIELD(lazyFlags.aux), RDX);
+	emitter.Store8(STATE_FIELD(lazyFlags.result), result);
+	emitter.Store8I(STATE_FIELD(lazyFlags.pending), 1);
+}
+
+void Jit::EmitArithmetic(uint8_t operation, Reg source, bool immediate, uint8_t value) {
+	static const AluOp operations[8] = { ALU_ADD, ALU_ADC, ALU_SUB, ALU_SBB, ALU_AND, ALU_XOR, ALU_OR, ALU_CMP };
+	AluOp op = operations[operation];
+
+	//every ALU op writes all the flags, so when none are live only the result is computed
+	bool flagsLive = liveFlags != 0;
+	if (!flagsLive && op == ALU_CMP) return;
+
+	//ANA sets AC from bit 3 of either operand, XRA and ORA clear it, the host leaves AF undefined for all three
+	bool logical = op == ALU_AND || op == ALU_XOR || op == ALU_OR;
+	if (flagsLive && op == ALU_AND) {
+		emitter.MovRR32(RDX, REG_A);
+		if (immediate) emitter.Alu32RI(ALU_OR, RDX, value);
+		else emitter.Alu32RR(ALU_OR, RDX, source);
+		emitter.Shift32RI(SHIFT_SHL, RDX, 1);
+		emitter.Alu32RI(ALU_AND, RDX, FLAG_AC);
+	} else if (flagsLive && logical) {
+		emitter.Alu32RR(ALU_XOR, RDX, RDX);
+	}
+
+	//8080 CY lines up with the host CF for both carry and borrow
+	if (op == ALU_ADC || op == ALU_SBB) {
+		emitter.LoadZX8(RDX, STATE_F);
+		emitter.Bt32(RDX, 0);
+	}
+
+	emitter.MovRR32(RAX, REG_A);
+	if (immediate) emitter.Alu8RI(op, RAX, value);
+	else emitter.Alu8RR(op, RAX, source);
+
+	//the 8080 subtracts by adding the complement, so AC is the inverted borrow
+	bool subtract = op == ALU_SUB || op == ALU_SBB || op == ALU_CMP;
+	if (flagsLive) {
+		EmitFlagResult(subtract ? FLAG_AC : 0, logical ? RDX : NO_REG);
+	}
+
+	//LAHF left the flags in AH
+	if (op != ALU_CMP) {
+		emitter.MovZX8(REG_A, RAX);
+	}
+
+	hostFlags = HOST_Z | HOST_S | HOST_P | HOST_CY;
+}
+
+//INR and DCR leave CY alone, and so does the host INC and DEC
+void Jit::EmitIncDec(uint8_t reg, bool decrement) {
+	if (reg == 6) {
+		EmitAddressHL();
+		EmitLoad(RAX);
+	} else {
+		emitter.MovRR32(RAX, hostRegs[reg]);
+	}
+
+	if (decrement) emitter.Dec8(RAX);
+	else emitter.Inc8(RAX);
+	if (liveFlags & FLAGS_RESULT) {
+		EmitLazyResult(RAX, decrement);
+	}
+
+	if (reg == 6) {
+		EmitStore(RAX);
+	} else {
+		emitter.MovZX8(hostRegs[reg], RAX);
+		hostFlags = HOST_Z | HOST_S | HOST_P;
+	}
+}
+
+//returns the host condition that holds when the 8080 condition is true
+Cond Jit::EmitCondition(uint8_t condition, uint8_t flags) {
+	enum { TEST_Z, TEST_CY, TEST_P, TEST_S };
+	static const uint8_t conditionFlags[8] = { TEST_Z, TEST_Z, TEST_CY, TEST_CY, TEST_P, TEST_P, TEST_S, TEST_S };
+	static const uint8_t hostFlagMasks[4] = { HOST_Z, HOST_CY, HOST_P, HOST_S };
+	static const uint8_t flagMasks[4] = { FLAG_Z, FLAG_CY, FLAG_P, FLAG_S };
+	static const Cond hostConditions[8] = { COND_NE, COND_E, COND_AE, COND_B, COND_NP, COND_P, COND_NS, COND_S };
+	static const bool whenSet[8] = { false, true, false, true, false, true, false, true };
+	uint8_t flag = conditionFlags[condition];
+
+	//the previous instruction left the flag in EFLAGS
+	if (flags & hostFlagMasks[flag]) {
+		return hostConditions[condition];
+	}
+
+	//otherwise read it the way CPU::Zero and friends do, from the lazy result while one is pending
+	emitter.LoadZX8(RAX, STATE_F);
+	emitter.Alu32RI(ALU_AND, RAX, flagMasks[flag]);
+	if (flag != TEST_CY) {
+		emitter.Alu8MI(ALU_CMP, STATE_FIELD(lazyFlags.pending), 0);
+		uint8_t* done = emitter.Jcc(COND_E);
+		emitter.LoadZX8(RAX, STATE_FIELD(lazyFlags.result));
+		if (flag == TEST_S) {
+			emitter.Shift32RI(SHIFT_SHR, RAX, 7);
+		} else {
+			emitter.Test32(RAX, RAX);
+			emitter.SetR(flag == TEST_Z ? COND_E : COND_P, RAX);
+		}
+		Emitter::Link(done, emitter.Position());
+	}
+
+	emitter.Test32(RAX, RAX);
+	return whenSet[condition] ? COND_NE : COND_E;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Emitter.h"
+
+//translated code uses mmap and the System V calling convention
+#if defined(__x86_64__) && defined(__linux__)
+#define CPU_JIT_SUPPORTED 1
+#else
+#define CPU_JIT_SUPPORTED 0
+#endif
+
+#define JIT_ARENA_SIZE (16 * 1024 * 1024)
+//worst case for one block, compiling flushes the arena when less than this is left
+#define JIT_BLOCK_RESERVE (256 * 1024)
+
+class CPU;
+struct State;
+
+//counters shared with translated code, which keeps a pointer to this in RBX
+struct JitContext {
+	uint64_t cycleCount;
+	uint64_t target;
+	uint64_t instructionCount;
+	//set when a store lands on a page holding translated code, which has been flushed
+	uint8_t flushed;
+};
+
+//translates 8080 basic blocks into x86-64, anything it can't translate runs in the interpreter
+class Jit {
+public:
+	Jit(CPU& cpu);
+	~Jit();
+
+	void Run(uint64_t target);
+	void Flush();
+
+private:
+	typedef void (*Entry)(JitContext* context, State* state, CPU* cpu, const uintptr_t* pages, uint8_t* block);
+
+	//an exit whose jump gets pointed straight at the target block once that is translated
+	struct Link {
+		uint8_t* field;
+		uint16_t target;
+	};
+
+	//a store that hit a translated page, leaves the block after the instruction with the registers already stored
+	struct Invalidation {
+		uint8_t* field;
+		uint16_t resume;
+		uint32_t cycles;
+		uint32_t instructions;
+	};
+
+	//a load or store on a page the bus sends to handlers, which goes through it out of line
+	//a store of count bytes writes values[0] first, each from its immediate when that is NO_REG
+	struct SlowAccess {
+		uint8_t* fields[2];
+		uint8_t* resume;
+		Reg values[2];
+		uint8_t immediates[2];
+		uint8_t count;
+		Invalidation invalidation;
+	};
+
+	CPU& cpu;
+	uint8_t* arena;
+	uint8_t* arenaStart;
+	Emitter emitter;
+	Entry enter;
+	uint8_t* exitStore;
+	uint8_t* exitNoStore;
+	JitContext context;
+
+	std::vector<uint8_t*> blocks;
+	//where each page that holds translated code was written before it was hooked, null when it wasn't
+	std::vector<uint8_t*> codePages;
+	std::unordered_map<uint16_t, std::vector<uint8_t*>> pendingLinks;
+	std::vector<Link> links;
+	std::vector<Invalidation> invalidations;
+	std::vector<SlowAccess> slowAccesses;
+	uint8_t hostFlags;
+	//flags read before the block overwrites them, for the instruction being emitted
+	uint8_t liveFlags;
+	uint32_t remainingCycles;
+	uint32_t remainingInstructions;
+	uint16_t nextPC;
+
+	void EmitTrampoline();
+	uint8_t* Compile(uint16_t pc);
+	void EmitInstruction(uint16_t pc, uint8_t opcode, uint16_t operand);
+	void EmitLoadRegisters();
+	void EmitStoreRegisters();
+	void EmitExit(uint16_t target);
+	void EmitExitIf(Cond cond, uint16_t target);
+	void EmitCall(uint16_t target);
+	void EmitReturn();
+	void EmitIndirectExit();
+	void EmitHelper(uint16_t pc, uint8_t opcode, uint16_t operand, bool leavesBlock);
+	void EmitPair(uint8_t pair, Reg dst);
+	void EmitSetPair(uint8_t pair, Reg src);
+	void EmitAddressHL();
+	void EmitLoad(Reg dst);
+	void EmitStore(Reg value, uint8_t immediate = 0);
+	void EmitMark();
+	void EmitStoreWord(Reg low, Reg high, uint16_t immediate = 0);
+	void EmitSlowLoad(const SlowAccess& access);
+	void EmitSlowStore(const SlowAccess& access);
+	void ProtectPage(uint16_t page);
+	void EmitCarry();
+	void EmitFlagResult(uint8_t flip, Reg aux);
+	void EmitLazyResult(Reg result, bool decrement);
+	void EmitArithmetic(uint8_t operation, Reg source, bool immediate, uint8_t value);
+	void EmitIncDec(uint8_t reg, bool decrement);
+	Cond EmitCondition(uint8_t condition, uint8_t flags);
+
+	static bool Translatable(uint8_t opcode);
+	static void ExecuteHelper(CPU* cpu, JitContext* context, uint32_t instruction);
+	static uint8_t ReadHelper(CPU* cpu, uint32_t address);
+	static void WriteHelper(CPU* cpu, uint32_t address, uint32_t value);
+	static void CodeWriteHandler(void* context, uint16_t address, uint8_t value);
+};
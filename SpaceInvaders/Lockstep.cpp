@@ -0,0 +1,725 @@
+#include "Lockstep.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+#include "Flags.h"
+
+Lockstep::Lockstep() : lanes() {
+	for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+		lanes.nextInterruptValue[lane] = 1;
+		lanes.nextInterruptCycle[lane] = HALF_FRAME_CYCLES;
+		ports[lane] = {};
+	}
+	rom.resize(ROM_SIZE);
+	ram.resize(RAM_SIZE);
+}
+
+void Lockstep::LoadROM(size_t size, const void* data) {
+	memcpy(rom.data(), data, std::min<size_t>(size, ROM_SIZE));
+}
+
+void Lockstep::SetInput(size_t lane, size_t index, uint8_t value) {
+	ports[lane].inputs[index] = value;
+}
+
+uint8_t Lockstep::GetOutput(size_t lane, size_t index) const {
+	return ports[lane].outputs[index];
+}
+
+void Lockstep::GetRAM(size_t lane, uint8_t* data) const {
+	for (size_t i = 0; i < RAM_SIZE; i++) {
+		data[i] = ram[i].lanes[lane];
+	}
+}
+
+State Lockstep::GetState(size_t lane) const {
+	State state = {};
+	state.bc.word = GetPair(lane, 0);
+	state.de.word = GetPair(lane, 2);
+	state.hl.word = GetPair(lane, 4);
+	state.a() = lanes.registers[7][lane];
+	state.f() = GetFlags(lane);
+	state.sp = GetSP(lane);
+	state.pc = GetPC(lane);
+	state.interruptEnable = lanes.interruptEnable[lane] & 1;
+	return state;
+}
+
+//the same map as the CPU's bus: ROM then RAM, mirrored every 16 KB, with writes to ROM dropped
+FORCE_INLINE uint8_t Lockstep::Read(size_t lane, uint16_t address) const {
+	address &= MIRROR_SIZE - 1;
+	if (address < ROM_SIZE) return rom[address];
+	return ram[address - ROM_SIZE].lanes[lane];
+}
+
+FORCE_INLINE void Lockstep::Write(size_t lane, uint16_t address, uint8_t value) {
+	address &= MIRROR_SIZE - 1;
+	if (address >= ROM_SIZE) ram[address - ROM_SIZE].lanes[lane] = value;
+}
+
+FORCE_INLINE uint16_t Lockstep::ReadWord(size_t lane, uint16_t address) const {
+	return static_cast<uint16_t>(Read(lane, address) | (Read(lane, static_cast<uint16_t>(address + 1)) << 8));
+}
+
+FORCE_INLINE void Lockstep::WriteWord(size_t lane, uint16_t address, uint16_t value) {
+	Write(lane, address, static_cast<uint8_t>(value));
+	Write(lane, static_cast<uint16_t>(address + 1), static_cast<uint8_t>(value >> 8));
+}
+
+//high is the register number of the pair's first register, B, D or H
+FORCE_INLINE uint16_t Lockstep::GetPair(size_t lane, uint8_t high) const {
+	return static_cast<uint16_t>((lanes.registers[high][lane] << 8) | lanes.registers[high + 1][lane]);
+}
+
+FORCE_INLINE void Lockstep::SetPair(size_t lane, uint8_t high, uint16_t value) {
+	lanes.registers[high][lane] = static_cast<uint8_t>(value >> 8);
+	lanes.registers[high + 1][lane] = static_cast<uint8_t>(value);
+}
+
+FORCE_INLINE uint16_t Lockstep::GetPC(size_t lane) const {
+	return static_cast<uint16_t>((lanes.pcHigh[lane] << 8) | lanes.pcLow[lane]);
+}
+
+FORCE_INLINE void Lockstep::SetPC(size_t lane, uint16_t value) {
+	lanes.pcHigh[lane] = static_cast<uint8_t>(value >> 8);
+	lanes.pcLow[lane] = static_cast<uint8_t>(value);
+}
+
+FORCE_INLINE uint16_t Lockstep::GetSP(size_t lane) const {
+	return static_cast<uint16_t>((lanes.spHigh[lane] << 8) | lanes.spLow[lane]);
+}
+
+FORCE_INLINE void Lockstep::SetSP(size_t lane, uint16_t value) {
+	lanes.spHigh[lane] = static_cast<uint8_t>(value >> 8);
+	lanes.spLow[lane] = static_cast<uint8_t>(value);
+}
+
+//F in the layout PUSH PSW writes
+FORCE_INLINE uint8_t Lockstep::GetFlags(size_t lane) const {
+	return static_cast<uint8_t>((lanes.sign[lane] & FLAG_S) | (lanes.zero[lane] & FLAG_Z) | (lanes.auxCarry[lane] & FLAG_AC) |
+		(lanes.parity[lane] & FLAG_P) | FLAG_ONE | (lanes.carry[lane] & FLAG_CY));
+}
+
+FORCE_INLINE void Lockstep::Push(size_t lane, uint16_t value) {
+	uint16_t sp = static_cast<uint16_t>(GetSP(lane) - 2);
+	SetSP(lane, sp);
+	WriteWord(lane, sp, value);
+}
+
+FORCE_INLINE uint16_t Lockstep::Pop(size_t lane) {
+	uint16_t sp = GetSP(lane);
+	SetSP(lane, static_cast<uint16_t>(sp + 2));
+	return ReadWord(lane, sp);
+}
+
+uint8_t Lockstep::ReadInput(size_t lane, uint8_t index) const {
+	const Ports& port = ports[lane];
+	if (index == 3) {
+		return static_cast<uint8_t>(port.shiftRegister >> (8 - (port.outputs[2] & 0x7)));
+	} else {
+		return port.inputs[index];
+	}
+}
+
+void Lockstep::WriteOutput(size_t lane, uint8_t index, uint8_t value) {
+	Ports& port = ports[lane];
+	if (index == 4) {
+		port.shiftRegister = static_cast<uint16_t>((value << 8) | (port.shiftRegister >> 8));
+	} else {
+		port.outputs[index] = value;
+	}
+}
+
+//RST 1 at mid-screen and RST 2 at VBlank, on each lane's own clock
+void Lockstep::CheckInterrupt(size_t lane) {
+	if (lanes.cycleCount[lane] >= lanes.nextInterruptCycle[lane]) {
+		if (lanes.interruptEnable[lane]) {
+			lanes.interruptEnable[lane] = 0;
+			Push(lane, GetPC(lane));
+			SetPC(lane, static_cast<uint16_t>(lanes.nextInterruptValue[lane] * 8));
+			lanes.cycleCount[lane] += INTERRUPT_CYCLES;
+		}
+		lanes.nextInterruptValue[lane] = lanes.nextInterruptValue[lane] == 1 ? 2 : 1;
+		lanes.nextInterruptCycle[lane] += HALF_FRAME_CYCLES;
+	}
+}
+
+FORCE_INLINE void Lockstep::Assign(uint8_t* target, ByteVector mask, ByteVector value) {
+	Select(mask, value, ByteVector::Load(target)).Store(target);
+}
+
+//true when the pair in high and low holds the same address in every lane of the group
+FORCE_INLINE bool Lockstep::Uniform(const uint8_t* high, const uint8_t* low, ByteVector mask, uint64_t bits, uint16_t& address) {
+	size_t lane = LowestBit(bits);
+	address = static_cast<uint16_t>((high[lane] << 8) | low[lane]);
+	ByteVector same = Equal(ByteVector::Load(high), ByteVector::Set(high[lane])) & Equal(ByteVector::Load(low), ByteVector::Set(low[lane]));
+	return Bits(AndNot(same, mask)) == 0;
+}
+
+FORCE_INLINE ByteVector Lockstep::ReadRow(uint16_t address) const {
+	address &= MIRROR_SIZE - 1;
+	if (address < ROM_SIZE) return ByteVector::Set(rom[address]);
+	return ByteVector::Load(ram[address - ROM_SIZE].lanes);
+}
+
+FORCE_INLINE void Lockstep::WriteRow(ByteVector mask, uint16_t address, ByteVector value) {
+	address &= MIRROR_SIZE - 1;
+	if (address >= ROM_SIZE) Assign(ram[address - ROM_SIZE].lanes, mask, value);
+}
+
+//stack access for a group with a uniform sp
+FORCE_INLINE void Lockstep::PushRows(ByteVector mask, uint16_t sp, ByteVector high, ByteVector low) {
+	sp -= 2;
+	WriteRow(mask, sp, low);
+	WriteRow(mask, static_cast<uint16_t>(sp + 1), high);
+	Assign(lanes.spLow, mask, ByteVector::Set(static_cast<uint8_t>(sp)));
+	Assign(lanes.spHigh, mask, ByteVector::Set(static_cast<uint8_t>(sp >> 8)));
+}
+
+FORCE_INLINE void Lockstep::PopRows(ByteVector mask, uint16_t sp, ByteVector& high, ByteVector& low) {
+	low = ReadRow(sp);
+	high = ReadRow(static_cast<uint16_t>(sp + 1));
+	sp += 2;
+	Assign(lanes.spLow, mask, ByteVector::Set(static_cast<uint8_t>(sp)));
+	Assign(lanes.spHigh, mask, ByteVector::Set(static_cast<uint8_t>(sp >> 8)));
+}
+
+//F for every lane, in the layout PUSH PSW writes
+FORCE_INLINE ByteVector Lockstep::GetFlags() const {
+	return (ByteVector::Load(lanes.sign) & ByteVector::Set(FLAG_S)) | (ByteVector::Load(lanes.zero) & ByteVector::Set(FLAG_Z)) |
+		(ByteVector::Load(lanes.auxCarry) & ByteVector::Set(FLAG_AC)) | (ByteVector::Load(lanes.parity) & ByteVector::Set(FLAG_P)) |
+		ByteVector::Set(FLAG_ONE) | (ByteVector::Load(lanes.carry) & ByteVector::Set(FLAG_CY));
+}
+
+FORCE_INLINE void Lockstep::SetFlags(ByteVector mask, ByteVector flags) {
+	ByteVector none = ByteVector::Set(0);
+	Assign(lanes.carry, mask, NotEqual(flags & ByteVector::Set(FLAG_CY), none));
+	Assign(lanes.parity, mask, NotEqual(flags & ByteVector::Set(FLAG_P), none));
+	Assign(lanes.auxCarry, mask, NotEqual(flags & ByteVector::Set(FLAG_AC), none));
+	Assign(lanes.zero, mask, NotEqual(flags & ByteVector::Set(FLAG_Z), none));
+	Assign(lanes.sign, mask, Negative(flags));
+}
+
+//bit 4 of aux holds the auxiliary carry, as for CPU::SetResultFlags
+FORCE_INLINE void Lockstep::SetResultFlags(ByteVector mask, ByteVector result, ByteVector aux) {
+	ByteVector none = ByteVector::Set(0);
+	Assign(lanes.zero, mask, Equal(result, none));
+	Assign(lanes.sign, mask, Negative(result));
+	Assign(lanes.parity, mask, EvenParity(result));
+	Assign(lanes.auxCarry, mask, NotEqual(aux & ByteVector::Set(FLAG_AC), none));
+}
+
+//operations in opcode order ADD, ADC, SUB, SBB, ANA, XRA, ORA, CMP
+template <uint8_t O>
+FORCE_INLINE void Lockstep::Arithmetic(ByteVector mask, ByteVector value) {
+	ByteVector a = ByteVector::Load(lanes.registers[7]);
+	ByteVector carryIn = ByteVector::Load(lanes.carry) & ByteVector::Set(1);
+	ByteVector result, carry, aux;
+
+	switch (O) {
+		case 0:
+			result = a + value;
+			carry = Carry(a, value);
+			aux = a ^ value ^ result;
+			break;
+		case 1:
+		{
+			ByteVector sum = a + value;
+			result = sum + carryIn;
+			carry = Carry(a, value) | Carry(sum, carryIn);
+			aux = a ^ value ^ result;
+			break;
+		}
+		case 2:
+		case 7:
+			result = a - value;
+			carry = Below(a, value);
+			aux = ~(a ^ value ^ result);
+			break;
+		case 3:
+		{
+			ByteVector difference = a - value;
+			result = difference - carryIn;
+			carry = Below(a, value) | Below(difference, carryIn);
+			aux = ~(a ^ value ^ result);
+			break;
+		}
+		case 4:
+			result = a & value;
+			carry = ByteVector::Set(0);
+			aux = ShiftLeft<1>(a | value);
+			break;
+		case 5:
+			result = a ^ value;
+			carry = ByteVector::Set(0);
+			aux = carry;
+			break;
+		default:
+			result = a | value;
+			carry = ByteVector::Set(0);
+			aux = carry;
+			break;
+	}
+
+	if (O != 7) Assign(lanes.registers[7], mask, result);
+	Assign(lanes.carry, mask, carry);
+	SetResultFlags(mask, result, aux);
+}
+
+//16-bit arithmetic on a pair split over two byte vectors, the low byte carries into the high one
+FORCE_INLINE void Lockstep::Increment(uint8_t* high, uint8_t* low, ByteVector mask) {
+	ByteVector result = ByteVector::Load(low) + ByteVector::Set(1);
+	Assign(high, mask, ByteVector::Load(high) - Equal(result, ByteVector::Set(0)));
+	Assign(low, mask, result);
+}
+
+FORCE_INLINE void Lockstep::Decrement(uint8_t* high, uint8_t* low, ByteVector mask) {
+	ByteVector value = ByteVector::Load(low);
+	Assign(high, mask, ByteVector::Load(high) + Equal(value, ByteVector::Set(0)));
+	Assign(low, mask, value - ByteVector::Set(1));
+}
+
+FORCE_INLINE void Lockstep::AddToHL(ByteVector mask, ByteVector high, ByteVector low) {
+	ByteVector h = ByteVector::Load(lanes.registers[4]);
+	ByteVector l = ByteVector::Load(lanes.registers[5]);
+	ByteVector lowCarry = Carry(l, low) & ByteVector::Set(1);
+	ByteVector highSum = h + high;
+
+	Assign(lanes.registers[5], mask, l + low);
+	Assign(lanes.registers[4], mask, highSum + lowCarry);
+	Assign(lanes.carry, mask, Carry(h, high) | Carry(highSum, lowCarry));
+}
+
+//registers in opcode order B, C, D, E, H, L, M, A
+//M is one row when HL agrees across the group, and is otherwise gathered and scattered a lane at a time
+template <uint8_t R>
+FORCE_INLINE ByteVector Lockstep::GetRegister(ByteVector mask, uint64_t bits) {
+	if (R != 6) return ByteVector::Load(lanes.registers[R]);
+
+	uint16_t address;
+	if (Uniform(lanes.registers[4], lanes.registers[5], mask, bits, address)) return ReadRow(address);
+
+	alignas(BYTE_VECTOR_SIZE) uint8_t values[LOCKSTEP_LANES] = {};
+	for (; bits; bits &= bits - 1) {
+		size_t lane = LowestBit(bits);
+		values[lane] = Read(lane, GetPair(lane, 4));
+	}
+	return ByteVector::Load(values);
+}
+
+template <uint8_t R>
+FORCE_INLINE void Lockstep::SetRegister(ByteVector mask, uint64_t bits, ByteVector value) {
+	if (R != 6) {
+		Assign(lanes.registers[R], mask, value);
+		return;
+	}
+
+	uint16_t address;
+	if (Uniform(lanes.registers[4], lanes.registers[5], mask, bits, address)) {
+		WriteRow(mask, address, value);
+		return;
+	}
+
+	alignas(BYTE_VECTOR_SIZE) uint8_t values[LOCKSTEP_LANES];
+	value.Store(values);
+	for (; bits; bits &= bits - 1) {
+		size_t lane = LowestBit(bits);
+		Write(lane, GetPair(lane, 4), values[lane]);
+	}
+}
+
+//pairs in opcode order BC, DE, HL, SP
+template <uint8_t P>
+FORCE_INLINE uint8_t* Lockstep::PairHigh() {
+	return P == 3 ? lanes.spHigh : lanes.registers[P * 2];
+}
+
+template <uint8_t P>
+FORCE_INLINE uint8_t* Lockstep::PairLow() {
+	return P == 3 ? lanes.spLow : lanes.registers[P * 2 + 1];
+}
+
+//conditions in opcode order NZ, Z, NC, C, PO, PE, P, M, as a mask of the lanes that take the branch
+template <uint8_t C>
+FORCE_INLINE ByteVector Lockstep::Condition() {
+	ByteVector flag;
+	switch (C >> 1) {
+		case 0: flag = ByteVector::Load(lanes.zero); break;
+		case 1: flag = ByteVector::Load(lanes.carry); break;
+		case 2: flag = ByteVector::Load(lanes.parity); break;
+		default: flag = ByteVector::Load(lanes.sign); break;
+	}
+	return (C & 1) ? flag : ~flag;
+}
+
+//pushes the return address and jumps, for CALL, a taken Ccc and RST
+FORCE_INLINE void Lockstep::Call(ByteVector mask, uint64_t bits, uint16_t next, uint16_t target) {
+	uint16_t sp;
+	if (Uniform(lanes.spHigh, lanes.spLow, mask, bits, sp)) {
+		PushRows(mask, sp, ByteVector::Set(static_cast<uint8_t>(next >> 8)), ByteVector::Set(static_cast<uint8_t>(next)));
+	} else {
+		for (; bits; bits &= bits - 1) {
+			Push(LowestBit(bits), next);
+		}
+	}
+	Assign(lanes.pcLow, mask, ByteVector::Set(static_cast<uint8_t>(target)));
+	Assign(lanes.pcHigh, mask, ByteVector::Set(static_cast<uint8_t>(target >> 8)));
+}
+
+FORCE_INLINE void Lockstep::Return(ByteVector mask, uint64_t bits) {
+	uint16_t sp;
+	if (Uniform(lanes.spHigh, lanes.spLow, mask, bits, sp)) {
+		ByteVector high, low;
+		PopRows(mask, sp, high, low);
+		Assign(lanes.pcLow, mask, low);
+		Assign(lanes.pcHigh, mask, high);
+	} else {
+		for (; bits; bits &= bits - 1) {
+			size_t lane = LowestBit(bits);
+			SetPC(lane, Pop(lane));
+		}
+	}
+}
+
+//mirrors CPU::Execute for every lane in mask at once; bits holds the same lanes, one bit each, for the work done a lane at a time
+//next is the address after the instruction, which every lane's pc already holds
+template <uint8_t Op>
+FORCE_INLINE void Lockstep::Execute(ByteVector mask, uint64_t bits, const uint8_t* inst, uint16_t next) {
+	constexpr uint8_t y = (Op >> 3) & 7;
+	constexpr uint8_t z = Op & 7;
+	constexpr uint8_t p = (Op >> 4) & 3;
+	uint16_t word = static_cast<uint16_t>(inst[1] | (inst[2] << 8));
+	uint8_t* a = lanes.registers[7];
+
+	if ((Op & 0xC0) == 0x40 && Op != 0x76) {	//MOV r, r
+		SetRegister<y>(mask, bits, GetRegister<z>(mask, bits));
+	} else if ((Op & 0xC0) == 0x80) {	//ADD r through CMP r
+		Arithmetic<y>(mask, GetRegister<z>(mask, bits));
+	} else if ((Op & 0xC7) == 0xC6) {	//ADI byte through CPI byte
+		Arithmetic<y>(mask, ByteVector::Set(inst[1]));
+	} else if ((Op & 0xC7) == 0x04) {	//INR r
+		ByteVector result = GetRegister<y>(mask, bits) + ByteVector::Set(1);
+		//AC when the low nibble wraps to 0
+		SetResultFlags(mask, result, Equal(result & ByteVector::Set(0x0F), ByteVector::Set(0)));
+		SetRegister<y>(mask, bits, result);
+	} else if ((Op & 0xC7) == 0x05) {	//DCR r
+		ByteVector result = GetRegister<y>(mask, bits) - ByteVector::Set(1);
+		SetResultFlags(mask, result, NotEqual(result & ByteVector::Set(0x0F), ByteVector::Set(0x0F)));
+		SetRegister<y>(mask, bits, result);
+	} else if ((Op & 0xC7) == 0x06) {	//MVI r, byte
+		SetRegister<y>(mask, bits, ByteVector::Set(inst[1]));
+	} else if ((Op & 0xCF) == 0x01) {	//LXI rp, word
+		Assign(PairHigh<p>(), mask, ByteVector::Set(inst[2]));
+		Assign(PairLow<p>(), mask, ByteVector::Set(inst[1]));
+	} else if ((Op & 0xCF) == 0x03) {	//INX rp
+		Increment(PairHigh<p>(), PairLow<p>(), mask);
+	} else if ((Op & 0xCF) == 0x0B) {	//DCX rp
+		Decrement(PairHigh<p>(), PairLow<p>(), mask);
+	} else if ((Op & 0xCF) == 0x09) {	//DAD rp
+		AddToHL(mask, ByteVector::Load(PairHigh<p>()), ByteVector::Load(PairLow<p>()));
+	} else if ((Op & 0xCF) == 0xC5) {	//PUSH rp
+		uint16_t sp;
+		if (Uniform(lanes.spHigh, lanes.spLow, mask, bits, sp)) {
+			PushRows(mask, sp, ByteVector::Load(p == 3 ? a : PairHigh<p>()), p == 3 ? GetFlags() : ByteVector::Load(PairLow<p>()));
+			return;
+		}
+		for (; bits; bits &= bits - 1) {
+			size_t lane = LowestBit(bits);
+			uint8_t low = p == 3 ? GetFlags(lane) : PairLow<p>()[lane];
+			uint8_t high = p == 3 ? a[lane] : PairHigh<p>()[lane];
+			Push(lane, static_cast<uint16_t>((high << 8) | low));
+		}
+	} else if ((Op & 0xCF) == 0xC1) {	//POP rp
+		uint16_t sp;
+		ByteVector high, low;
+		if (Uniform(lanes.spHigh, lanes.spLow, mask, bits, sp)) {
+			PopRows(mask, sp, high, low);
+		} else {
+			alignas(BYTE_VECTOR_SIZE) uint8_t highs[LOCKSTEP_LANES] = {};
+			alignas(BYTE_VECTOR_SIZE) uint8_t lows[LOCKSTEP_LANES] = {};
+			for (; bits; bits &= bits - 1) {
+				size_t lane = LowestBit(bits);
+				uint16_t value = Pop(lane);
+				highs[lane] = static_cast<uint8_t>(value >> 8);
+				lows[lane] = static_cast<uint8_t>(value);
+			}
+			high = ByteVector::Load(highs);
+			low = ByteVector::Load(lows);
+		}
+		if (p == 3) {
+			Assign(a, mask, high);
+			SetFlags(mask, low);
+		} else {
+			Assign(PairHigh<p>(), mask, high);
+			Assign(PairLow<p>(), mask, low);
+		}
+	} else if ((Op & 0xC7) == 0xC2) {	//Jcc addr
+		ByteVector taken = mask & Condition<y>();
+		Assign(lanes.pcLow, taken, ByteVector::Set(inst[1]));
+		Assign(lanes.pcHigh, taken, ByteVector::Set(inst[2]));
+	} else if ((Op & 0xC7) == 0xC4) {	//Ccc addr
+		ByteVector taken = mask & Condition<y>();
+		uint64_t takenBits = Bits(taken);
+		for (uint64_t rest = takenBits; rest; rest &= rest - 1) {
+			lanes.cycleCount[LowestBit(rest)] += opcodeTable.entries[Op].takenCycles;
+		}
+		if (takenBits) Call(taken, takenBits, next, word);
+	} else if ((Op & 0xC7) == 0xC0) {	//Rcc
+		ByteVector taken = mask & Condition<y>();
+		uint64_t takenBits = Bits(taken);
+		for (uint64_t rest = takenBits; rest; rest &= rest - 1) {
+			lanes.cycleCount[LowestBit(rest)] += opcodeTable.entries[Op].takenCycles;
+		}
+		if (takenBits) Return(taken, takenBits);
+	} else if ((Op & 0xC7) == 0xC7) {	//RST n
+		Call(mask, bits, next, y * 8);
+	} else {
+		switch (Op) {
+			default:
+				throw std::runtime_error("Unrecognized instruction");
+			case 0x00:	//NOP
+			case 0x08:
+			case 0x20:
+				break;
+			case 0x02:	//STAX B
+			case 0x12:	//STAX D
+			{
+				uint16_t address;
+				if (Uniform(PairHigh<p>(), PairLow<p>(), mask, bits, address)) {
+					WriteRow(mask, address, ByteVector::Load(a));
+					break;
+				}
+				for (; bits; bits &= bits - 1) {
+					size_t lane = LowestBit(bits);
+					Write(lane, GetPair(lane, p * 2), a[lane]);
+				}
+				break;
+			}
+			case 0x0A:	//LDAX B
+			case 0x1A:	//LDAX D
+			{
+				uint16_t address;
+				if (Uniform(PairHigh<p>(), PairLow<p>(), mask, bits, address)) {
+					Assign(a, mask, ReadRow(address));
+					break;
+				}
+				for (; bits; bits &= bits - 1) {
+					size_t lane = LowestBit(bits);
+					a[lane] = Read(lane, GetPair(lane, p * 2));
+				}
+				break;
+			}
+			case 0x07:	//RLC
+			{
+				ByteVector value = ByteVector::Load(a);
+				Assign(lanes.carry, mask, Negative(value));
+				Assign(a, mask, ShiftLeft<1>(value) | ShiftRight<7>(value));
+				break;
+			}
+			case 0x0F:	//RRC
+			{
+				ByteVector value = ByteVector::Load(a);
+				Assign(lanes.carry, mask, NotEqual(value & ByteVector::Set(1), ByteVector::Set(0)));
+				Assign(a, mask, ShiftRight<1>(value) | ShiftLeft<7>(value));
+				break;
+			}
+			case 0x17:	//RAL
+			{
+				ByteVector value = ByteVector::Load(a);
+				ByteVector carryIn = ByteVector::Load(lanes.carry) & ByteVector::Set(0x01);
+				Assign(lanes.carry, mask, Negative(value));
+				Assign(a, mask, ShiftLeft<1>(value) | carryIn);
+				break;
+			}
+			case 0x1F:	//RAR
+			{
+				ByteVector value = ByteVector::Load(a);
+				ByteVector carryIn = ByteVector::Load(lanes.carry) & ByteVector::Set(0x80);
+				Assign(lanes.carry, mask, NotEqual(value & ByteVector::Set(1), ByteVector::Set(0)));
+				Assign(a, mask, ShiftRight<1>(value) | carryIn);
+				break;
+			}
+			case 0x22:	//SHLD addr
+				WriteRow(mask, word, ByteVector::Load(lanes.registers[5]));
+				WriteRow(mask, static_cast<uint16_t>(word + 1), ByteVector::Load(lanes.registers[4]));
+				break;
+			case 0x27:	//DAA
+			{
+				ByteVector value = ByteVector::Load(a);
+				ByteVector carry = ByteVector::Load(lanes.carry);
+				ByteVector lsb = value & ByteVector::Set(0x0F);
+				ByteVector msb = ShiftRight<4>(value);
+				ByteVector lowOver = Below(ByteVector::Set(9), lsb);
+				ByteVector low = ByteVector::Load(lanes.auxCarry) | lowOver;
+				ByteVector high = carry | Below(ByteVector::Set(9), msb) | (Below(ByteVector::Set(8), msb) & lowOver);
+				Arithmetic<0>(mask, (low & ByteVector::Set(0x06)) | (high & ByteVector::Set(0x60)));
+				Assign(lanes.carry, mask, high);
+				break;
+			}
+			case 0x2A:	//LHLD addr
+				Assign(lanes.registers[5], mask, ReadRow(word));
+				Assign(lanes.registers[4], mask, ReadRow(static_cast<uint16_t>(word + 1)));
+				break;
+			case 0x2F:	//CMA
+				Assign(a, mask, ~ByteVector::Load(a));
+				break;
+			case 0x32:	//STA addr
+				WriteRow(mask, word, ByteVector::Load(a));
+				break;
+			case 0x37:	//STC
+				Assign(lanes.carry, mask, ByteVector::Set(0xFF));
+				break;
+			case 0x3A:	//LDA addr
+				Assign(a, mask, ReadRow(word));
+				break;
+			case 0x3F:	//CMC
+				Assign(lanes.carry, mask, ~ByteVector::Load(lanes.carry));
+				break;
+			case 0xC3:	//JMP addr
+				Assign(lanes.pcLow, mask, ByteVector::Set(inst[1]));
+				Assign(lanes.pcHigh, mask, ByteVector::Set(inst[2]));
+				break;
+			case 0xC9:	//RET
+				Return(mask, bits);
+				break;
+			case 0xCD:	//CALL addr
+				Call(mask, bits, next, word);
+				break;
+			case 0xD3:	//OUT byte
+				for (; bits; bits &= bits - 1) {
+					size_t lane = LowestBit(bits);
+					WriteOutput(lane, inst[1], a[lane]);
+				}
+				break;
+			case 0xDB:	//IN byte
+				for (; bits; bits &= bits - 1) {
+					size_t lane = LowestBit(bits);
+					a[lane] = ReadInput(lane, inst[1]);
+				}
+				break;
+			case 0xE3:	//XTHL
+				for (; bits; bits &= bits - 1) {
+					size_t lane = LowestBit(bits);
+					uint16_t temp = GetPair(lane, 4);
+					SetPair(lane, 4, Pop(lane));
+					Push(lane, temp);
+				}
+				break;
+			case 0xE9:	//PCHL
+				Assign(lanes.pcLow, mask, ByteVector::Load(lanes.registers[5]));
+				Assign(lanes.pcHigh, mask, ByteVector::Load(lanes.registers[4]));
+				break;
+			case 0xEB:	//XCHG
+			{
+				ByteVector d = ByteVector::Load(lanes.registers[2]);
+				ByteVector e = ByteVector::Load(lanes.registers[3]);
+				Assign(lanes.registers[2], mask, ByteVector::Load(lanes.registers[4]));
+				Assign(lanes.registers[3], mask, ByteVector::Load(lanes.registers[5]));
+				Assign(lanes.registers[4], mask, d);
+				Assign(lanes.registers[5], mask, e);
+				break;
+			}
+			case 0xF3:	//DI
+				Assign(lanes.interruptEnable, mask, ByteVector::Set(0));
+				break;
+			case 0xFB:	//EI
+				Assign(lanes.interruptEnable, mask, ByteVector::Set(0xFF));
+				break;
+		}
+	}
+}
+
+template <uint8_t Op>
+void Lockstep::Handle(Lockstep& core, ByteVector mask, uint64_t bits, const uint8_t* inst, uint16_t next) {
+	core.Execute<Op>(mask, bits, inst, next);
+}
+
+template <size_t... Ops>
+constexpr std::array<Lockstep::Handler, 256> Lockstep::MakeHandlers(std::index_sequence<Ops...>) {
+	return { { &Lockstep::Handle<static_cast<uint8_t>(Ops)>... } };
+}
+
+void Lockstep::RunFrame() {
+	static constexpr std::array<Handler, 256> handlers = MakeHandlers(std::make_index_sequence<256>{});
+
+	cycleLimit += FRAME_CYCLES;
+
+	uint64_t active = 0;
+	for (size_t lane = 0; lane < LOCKSTEP_LANES; lane++) {
+		bool running = lanes.cycleCount[lane] < cycleLimit;
+		lanes.active[lane] = running ? 0xFF : 0;
+		if (running) active |= static_cast<uint64_t>(1) << lane;
+	}
+
+	while (active) {
+		//interrupts are taken before a lane's next instruction, as CPU::Run does
+		size_t leader = 0;
+		uint64_t least = UINT64_MAX;
+		for (uint64_t bits = active; bits; bits &= bits - 1) {
+			size_t lane = LowestBit(bits);
+			if (lanes.cycleCount[lane] < cycleLimit) {
+				while (lanes.cycleCount[lane] >= lanes.nextInterruptCycle[lane]) {
+					CheckInterrupt(lane);
+				}
+			}
+			if (lanes.cycleCount[lane] >= cycleLimit) {
+				lanes.active[lane] = 0;
+				active &= ~(static_cast<uint64_t>(1) << lane);
+			} else if (lanes.cycleCount[lane] < least) {
+				least = lanes.cycleCount[lane];
+				leader = lane;
+			}
+		}
+		if (!active) break;
+
+		//only ROM is the same for every lane, code elsewhere runs a lane at a time
+		uint16_t pc = GetPC(leader);
+		bool shared = (pc & (MIRROR_SIZE - 1)) + 2 < ROM_SIZE;
+		ByteVector mask;
+		if (shared) {
+			mask = Equal(ByteVector::Load(lanes.pcLow), ByteVector::Set(static_cast<uint8_t>(pc))) &
+				Equal(ByteVector::Load(lanes.pcHigh), ByteVector::Set(static_cast<uint8_t>(pc >> 8))) &
+				ByteVector::Load(lanes.active);
+		} else {
+			alignas(BYTE_VECTOR_SIZE) uint8_t single[LOCKSTEP_LANES] = {};
+			single[leader] = 0xFF;
+			mask = ByteVector::Load(single);
+		}
+		uint64_t bits = Bits(mask);
+
+		//the group runs until one of its lanes is due an interrupt or reaches the limit
+		uint64_t budget = UINT64_MAX;
+		uint64_t count = 0;
+		for (uint64_t rest = bits; rest; rest &= rest - 1) {
+			size_t lane = LowestBit(rest);
+			budget = std::min(budget, std::min(lanes.nextInterruptCycle[lane], cycleLimit) - lanes.cycleCount[lane]);
+			count++;
+		}
+
+		//the lanes stay together to the end of the basic block, where they may branch apart or others may join
+		//until then they all spend the same cycles, so the count is kept once for the group
+		uint64_t elapsed = 0;
+		while (elapsed < budget) {
+			uint8_t inst[3] = { Read(leader, pc), Read(leader, static_cast<uint16_t>(pc + 1)), Read(leader, static_cast<uint16_t>(pc + 2)) };
+			const OpcodeInfo& info = opcodeTable.entries[inst[0]];
+			uint16_t next = static_cast<uint16_t>(pc + info.length);
+
+			Assign(lanes.pcLow, mask, ByteVector::Set(static_cast<uint8_t>(next)));
+			Assign(lanes.pcHigh, mask, ByteVector::Set(static_cast<uint8_t>(next >> 8)));
+			handlers[inst[0]](*this, mask, bits, inst, next);
+			elapsed += info.cycles;
+			instructionCount += count;
+			stepCount++;
+
+			pc = next;
+			if (info.endsBlock || (shared && (pc & (MIRROR_SIZE - 1)) + 2 >= ROM_SIZE)) break;
+		}
+
+		for (; bits; bits &= bits - 1) {
+			size_t lane = LowestBit(bits);
+			lanes.cycleCount[lane] += elapsed;
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+#include <array>
+#include <utility>
+
+#include "CPU.h"
+#include "ByteVector.h"
+
+//one instance per byte of a vector register
+#define LOCKSTEP_LANES BYTE_VECTOR_SIZE
+
+//an experimental core that runs LOCKSTEP_LANES instances of one ROM side by side
+//registers and flags are stored a byte per lane, so one vector operation executes an instruction for every lane at the same pc
+//the lane furthest behind picks the next pc, and lanes anywhere else wait for it to come round
+class Lockstep {
+public:
+	Lockstep();
+
+	void LoadROM(size_t size, const void* data);
+	void SetInput(size_t lane, size_t index, uint8_t value);
+	uint8_t GetOutput(size_t lane, size_t index) const;
+	//runs every lane for a video frame of cycles, like AddFrame and Run on a CPU
+	void RunFrame();
+
+	//copies out the lane's RAM_SIZE bytes of RAM, which are interleaved with the other lanes'
+	void GetRAM(size_t lane, uint8_t* data) const;
+	//the lane's registers with F assembled from the flags, memory is left empty
+	State GetState(size_t lane) const;
+	uint64_t GetCycleCount(size_t lane) const { return lanes.cycleCount[lane]; }
+	//summed over all lanes
+	uint64_t GetInstructionCount() const { return instructionCount; }
+	//vector steps, instructions per step is how many lanes ran together on average
+	uint64_t GetStepCount() const { return stepCount; }
+
+private:
+	typedef void (*Handler)(Lockstep& core, ByteVector mask, uint64_t bits, const uint8_t* inst, uint16_t next);
+
+	struct Ports {
+		uint8_t inputs[4];
+		uint8_t outputs[7];
+		uint16_t shiftRegister;
+	};
+
+	//flags hold 0xFF where set, so a condition is a lane mask as it stands
+	//every lane's byte at one address, so lanes that agree on an address read or write it with one vector access
+	struct alignas(BYTE_VECTOR_SIZE) Row {
+		uint8_t lanes[LOCKSTEP_LANES];
+	};
+
+	struct alignas(BYTE_VECTOR_SIZE) Lanes {
+		//B, C, D, E, H, L and A at their opcode register numbers, 6 is M and unused
+		uint8_t registers[8][LOCKSTEP_LANES];
+		uint8_t spLow[LOCKSTEP_LANES];
+		uint8_t spHigh[LOCKSTEP_LANES];
+		uint8_t pcLow[LOCKSTEP_LANES];
+		uint8_t pcHigh[LOCKSTEP_LANES];
+		uint8_t carry[LOCKSTEP_LANES];
+		uint8_t zero[LOCKSTEP_LANES];
+		uint8_t sign[LOCKSTEP_LANES];
+		uint8_t parity[LOCKSTEP_LANES];
+		uint8_t auxCarry[LOCKSTEP_LANES];
+		uint8_t interruptEnable[LOCKSTEP_LANES];
+		//0xFF for lanes still short of the cycle limit
+		uint8_t active[LOCKSTEP_LANES];
+		uint8_t nextInterruptValue[LOCKSTEP_LANES];
+		uint64_t cycleCount[LOCKSTEP_LANES];
+		uint64_t nextInterruptCycle[LOCKSTEP_LANES];
+	};
+
+	Lanes lanes;
+	Ports ports[LOCKSTEP_LANES];
+	std::vector<uint8_t> rom;
+	std::vector<Row> ram;
+	uint64_t cycleLimit = 0;
+	uint64_t instructionCount = 0;
+	uint64_t stepCount = 0;
+
+	uint8_t Read(size_t lane, uint16_t address) const;
+	void Write(size_t lane, uint16_t address, uint8_t value);
+	uint16_t ReadWord(size_t lane, uint16_t address) const;
+	void WriteWord(size_t lane, uint16_t address, uint16_t value);
+	uint16_t GetPair(size_t lane, uint8_t high) const;
+	void SetPair(size_t lane, uint8_t high, uint16_t value);
+	uint16_t GetPC(size_t lane) const;
+	void SetPC(size_t lane, uint16_t value);
+	uint16_t GetSP(size_t lane) const;
+	void SetSP(size_t lane, uint16_t value);
+	uint8_t GetFlags(size_t lane) const;
+	void Push(size_t lane, uint16_t value);
+	uint16_t Pop(size_t lane);
+	uint8_t ReadInput(size_t lane, uint8_t index) const;
+	void WriteOutput(size_t lane, uint8_t index, uint8_t value);
+	void CheckInterrupt(size_t lane);
+
+	static void Assign(uint8_t* target, ByteVector mask, ByteVector value);
+	static bool Uniform(const uint8_t* high, const uint8_t* low, ByteVector mask, uint64_t bits, uint16_t& address);
+	ByteVector ReadRow(uint16_t address) const;
+	void WriteRow(ByteVector mask, uint16_t address, ByteVector value);
+	void PushRows(ByteVector mask, uint16_t sp, ByteVector high, ByteVector low);
+	void PopRows(ByteVector mask, uint16_t sp, ByteVector& high, ByteVector& low);
+	void Call(ByteVector mask, uint64_t bits, uint16_t next, uint16_t target);
+	void Return(ByteVector mask, uint64_t bits);
+	ByteVector GetFlags() const;
+	void SetFlags(ByteVector mask, ByteVector flags);
+	void SetResultFlags(ByteVector mask, ByteVector result, ByteVector aux);
+	void Increment(uint8_t* high, uint8_t* low, ByteVector mask);
+	void Decrement(uint8_t* high, uint8_t* low, ByteVector mask);
+	void AddToHL(ByteVector mask, ByteVector high, ByteVector low);
+
+	template <uint8_t R>
+	ByteVector GetRegister(ByteVector mask, uint64_t bits);
+	template <uint8_t R>
+	void SetRegister(ByteVector mask, uint64_t bits, ByteVector value);
+	template <uint8_t O>
+	void Arithmetic(ByteVector mask, ByteVector value);
+	template <uint8_t P>
+	uint8_t* PairHigh();
+	template <uint8_t P>
+	uint8_t* PairLow();
+	template <uint8_t C>
+	ByteVector Condition();
+	template <uint8_t Op>
+	void Execute(ByteVector mask, uint64_t bits, const uint8_t* inst, uint16_t next);
+
+	template <uint8_t Op>
+	static void Handle(Lockstep& core, ByteVector mask, uint64_t bits, const uint8_t* inst, uint16_t next);
+	template <size_t... Ops>
+	static constexpr std::array<Handler, 256> MakeHandlers(std::index_sequence<Ops...>);
+};
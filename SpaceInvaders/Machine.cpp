@@ -1,32 +1,89 @@
 #include "Machine.h"
+#include <cstring>
 
-Machine::Machine() : display(cpu) {
+Machine::Machine(const MachineOptions& options) : display(cpu), frameSkip(options.fastForward, true), pacer(options.speed * options.fastForward) {
 	std::vector<char> rom = LoadFile("invaders.rom");
 
 	cpu.LoadROM(rom.size(), rom.data());
 
+	if (options.runAheadFrames > 0) {
+		runAhead.reset(new RunAhead(cpu, display, options.runAheadFrames));
+		return;
+	}
+
+	display.UsePublishedFrames();
 	emuThread = std::thread([=] {
 		Emulate();
 	});
 }
 
 Machine::~Machine() {
+	Stop();
+}
+
+void Machine::Stop() {
 	running = false;
-	emuThread.join();
+	if (emuThread.joinable()) emuThread.join();
 }
 
+//the emulation thread keeps its own time, so presenting only converts the newest frame it has published
+//run-ahead frames are counted from the wall clock, frames run without being presented just leave their rows dirty
 void Machine::Run() {
+	RowSet unchanged;
+
 	while (!glfwWindowShouldClose(renderer.GetWindow())) {
 		glfwPollEvents();
-		display.ConvertImage();
-		memcpy(renderer.GetVRAMMapping(), display.GetImage().data(), IMAGE_WIDTH * IMAGE_HEIGHT * 4);
-		renderer.Render();
-		cpu.AddFrame();
+		PollInput();
+
+		//run-ahead converts the frame it ran to, there is no emulation thread to hand frames to
+		bool converted = true;
+		if (runAhead) {
+			size_t frames = frameSkip.NextFrames(std::chrono::steady_clock::now());
+			if (frames > 0) {
+				cpu.SetInput(INPUT_PORT_PLAYER, input.load(std::memory_order_relaxed));
+				runAhead->RunFrame(frames);
+			} else {
+				converted = false;
+			}
+		} else {
+			display.ConvertImage();
+		}
+
+		const RowSet& rows = converted ? display.GetChangedRows() : unchanged;
+		uint8_t* mapping = static_cast<uint8_t*>(renderer.GetVRAMMapping());
+		for (size_t row = 0; row < IMAGE_HEIGHT; row++) {
+			if (!rows[row]) continue;
+			memcpy(mapping + row * IMAGE_WIDTH * 4, &display.GetImage()[row * IMAGE_WIDTH], IMAGE_WIDTH * 4);
+		}
+
+		renderer.Render(rows);
 	}
+
+	Stop();
+}
+
+//C inserts a coin, 1 and 2 start, the arrows move and space fires
+void Machine::PollInput() {
+	GLFWwindow* window = renderer.GetWindow();
+	uint8_t value = INPUT_ALWAYS_ON;
+
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) value |= INPUT_COIN;
+	if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) value |= INPUT_P1_START;
+	if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) value |= INPUT_P2_START;
+	if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) value |= INPUT_P1_FIRE;
+	if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) value |= INPUT_P1_LEFT;
+	if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) value |= INPUT_P1_RIGHT;
+
+	input.store(value, std::memory_order_relaxed);
 }
 
+//one frame of cycles per tick, handed to the display at VBlank, sleeping out the rest of the tick instead of polling for the next
 void Machine::Emulate() {
+	pacer.Start();
 	while (running) {
-		cpu.Step();
+		cpu.SetInput(INPUT_PORT_PLAYER, input.load(std::memory_order_relaxed));
+		cpu.RunFrame();
+		display.Publish();
+		pacer.Wait();
 	}
 }
\ No newline at end of file
@@ -1,25 +1,48 @@
 #pragma once
 
 #include <thread>
+#include <atomic>
+#include <memory>
 #include "CPU.h"
 #include "Display.h"
 #include "Renderer.h"
+#include "RunAhead.h"
+#include "FrameSkip.h"
+#include "FramePacer.h"
 #include "Utilities.h"
 
+struct MachineOptions {
+	//above 0 runs the CPU on the render thread, so the frame it shows has the latest input
+	size_t runAheadFrames = 0;
+	//times real time the game runs at, whatever rate the display presents at
+	size_t fastForward = 1;
+	//a further multiplier for the emulation thread's pacer, run-ahead only counts whole frames
+	double speed = 1.0;
+};
+
 class Machine {
 public:
-	Machine();
+	Machine(const MachineOptions& options = {});
 	~Machine();
 
 	void Run();
+	//the emulation thread has stopped once Run returns, so these are final
+	const FramePacer& GetPacer() const { return pacer; }
 
 private:
 	CPU cpu;
 	Display display;
 	Renderer renderer;
+	std::unique_ptr<RunAhead> runAhead;
+	//run-ahead runs frames on the render thread, so they are counted against the wall clock there
+	FrameSkip frameSkip;
+	FramePacer pacer;
 	std::thread emuThread;
-	bool running = true;
+	std::atomic<bool> running{ true };
+	//player 1 port, polled on the render thread and applied by whichever thread runs the CPU
+	std::atomic<uint8_t> input{ INPUT_ALWAYS_ON };
 
+	void PollInput();
 	void Emulate();
+	void Stop();
 };
-
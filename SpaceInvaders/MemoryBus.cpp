@@ -0,0 +1,78 @@
+#include "MemoryBus.h"
+
+static uint8_t OpenBus(void*, uint16_t) {
+	return 0xFF;
+}
+
+static void IgnoreWrite(void*, uint16_t, uint8_t) {
+}
+
+//unmapped pages read as 0xFF and ignore writes
+MemoryBus::MemoryBus() : readPages(), writePages(), markPages(), discard() {
+	MapReadHandler(0, 0x10000, &OpenBus, nullptr);
+	MapWriteHandler(0, 0x10000, &IgnoreWrite, nullptr);
+}
+
+void MemoryBus::MapRead(uint16_t start, uint32_t size, const uint8_t* data) {
+	for (uint32_t offset = 0; offset < size; offset += PAGE_SIZE) {
+		uint32_t address = start + offset;
+		readPages[address >> PAGE_SHIFT] = reinterpret_cast<uintptr_t>(data + offset) - address;
+	}
+}
+
+void MemoryBus::MapWrite(uint16_t start, uint32_t size, uint8_t* data) {
+	for (uint32_t offset = 0; offset < size; offset += PAGE_SIZE) {
+		uint32_t address = start + offset;
+		writePages[address >> PAGE_SHIFT] = reinterpret_cast<uintptr_t>(data + offset) - address;
+	}
+}
+
+void MemoryBus::MapReadHandler(uint16_t start, uint32_t size, ReadHandler handler, void* context) {
+	for (uint32_t address = start; address < start + size; address += PAGE_SIZE) {
+		readPages[address >> PAGE_SHIFT] = 0;
+		handlers[address >> PAGE_SHIFT].read = handler;
+		handlers[address >> PAGE_SHIFT].readContext = context;
+	}
+}
+
+void MemoryBus::MapWriteHandler(uint16_t start, uint32_t size, WriteHandler handler, void* context) {
+	for (uint32_t address = start; address < start + size; address += PAGE_SIZE) {
+		writePages[address >> PAGE_SHIFT] = 0;
+		handlers[address >> PAGE_SHIFT].write = handler;
+		handlers[address >> PAGE_SHIFT].writeContext = context;
+	}
+}
+
+void MemoryBus::DiscardWrites(uint16_t start, uint32_t size) {
+	for (uint32_t address = start; address < start + size; address += PAGE_SIZE) {
+		writePages[address >> PAGE_SHIFT] = reinterpret_cast<uintptr_t>(discard) - address;
+	}
+}
+
+void MemoryBus::MarkWrites(uint16_t start, uint32_t size, uint8_t* marks) {
+	for (uint32_t address = start; address < start + size; address += PAGE_SIZE) {
+		markPages[address >> PAGE_SHIFT] = reinterpret_cast<uintptr_t>(marks) - (start >> WRITE_MARK_SHIFT);
+	}
+}
+
+const uint8_t* MemoryBus::GetReadPointer(uint16_t address) const {
+	uintptr_t page = readPages[address >> PAGE_SHIFT];
+	return page ? reinterpret_cast<const uint8_t*>(page + address) : nullptr;
+}
+
+uint8_t* MemoryBus::GetWritePointer(uint16_t address) const {
+	uintptr_t page = writePages[address >> PAGE_SHIFT];
+	uint8_t* pointer = reinterpret_cast<uint8_t*>(page + address);
+	if (!page || (pointer >= discard && pointer < discard + PAGE_SIZE)) return nullptr;
+	return pointer;
+}
+
+uint8_t MemoryBus::ReadHandled(uint16_t address) const {
+	const Handlers& page = handlers[address >> PAGE_SHIFT];
+	return page.read(page.readContext, address);
+}
+
+void MemoryBus::WriteHandled(uint16_t address, uint8_t value) {
+	const Handlers& page = handlers[address >> PAGE_SHIFT];
+	page.write(page.writeContext, address, value);
+}
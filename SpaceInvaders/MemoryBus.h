@@ -0,0 +1,88 @@
+#pragma once
+#include <stdint.h>
+
+#define PAGE_SHIFT 8
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define PAGE_COUNT (0x10000 >> PAGE_SHIFT)
+//a marked page sets one byte for every this many bytes stored to it, a row of the display
+#define WRITE_MARK_SHIFT 5
+
+//the 64 KB address space in 256-byte pages, each mapped straight onto host memory or routed through handlers
+//a direct entry holds the host address of the page minus its guest address, so entry + address points at the byte
+//an entry of 0 sends the access to the page's handler instead
+//a page can also be marked, so a direct store sets a flag next to it, which finds what changed without a handler on the store path
+class MemoryBus {
+public:
+	typedef uint8_t (*ReadHandler)(void* context, uint16_t address);
+	typedef void (*WriteHandler)(void* context, uint16_t address, uint8_t value);
+
+	MemoryBus();
+
+	//start and size are multiples of PAGE_SIZE, data covers the whole range
+	void MapRead(uint16_t start, uint32_t size, const uint8_t* data);
+	void MapWrite(uint16_t start, uint32_t size, uint8_t* data);
+	void MapReadHandler(uint16_t start, uint32_t size, ReadHandler handler, void* context);
+	void MapWriteHandler(uint16_t start, uint32_t size, WriteHandler handler, void* context);
+	//writes land in a scratch page nothing reads, for ROM
+	void DiscardWrites(uint16_t start, uint32_t size);
+	//a direct store to address sets marks[(address - start) >> WRITE_MARK_SHIFT] to 1, the mapping itself is left alone
+	void MarkWrites(uint16_t start, uint32_t size, uint8_t* marks);
+
+	uint8_t Read(uint16_t address) const {
+		uintptr_t page = readPages[address >> PAGE_SHIFT];
+		if (page) return *reinterpret_cast<const uint8_t*>(page + address);
+		return ReadHandled(address);
+	}
+
+	void Write(uint16_t address, uint8_t value) {
+		uintptr_t page = writePages[address >> PAGE_SHIFT];
+		if (page) {
+			*reinterpret_cast<uint8_t*>(page + address) = value;
+			Mark(address);
+		} else {
+			WriteHandled(address, value);
+		}
+	}
+
+	//for handlers that store to marked memory themselves
+	void Mark(uint16_t address) {
+		uintptr_t marks = markPages[address >> PAGE_SHIFT];
+		if (marks) *reinterpret_cast<uint8_t*>(marks + (address >> WRITE_MARK_SHIFT)) = 1;
+	}
+
+	uint16_t ReadWord(uint16_t address) const {
+		return static_cast<uint16_t>(Read(address) | (Read(static_cast<uint16_t>(address + 1)) << 8));
+	}
+
+	void WriteWord(uint16_t address, uint16_t value) {
+		Write(address, static_cast<uint8_t>(value));
+		Write(static_cast<uint16_t>(address + 1), static_cast<uint8_t>(value >> 8));
+	}
+
+	//host memory behind a direct page, null if the page has handlers or discards writes
+	const uint8_t* GetReadPointer(uint16_t address) const;
+	uint8_t* GetWritePointer(uint16_t address) const;
+
+	//the JIT walks these itself
+	const uintptr_t* GetReadPages() const { return readPages; }
+	const uintptr_t* GetWritePages() const { return writePages; }
+	const uintptr_t* GetMarkPages() const { return markPages; }
+
+private:
+	struct Handlers {
+		ReadHandler read;
+		WriteHandler write;
+		void* readContext;
+		void* writeContext;
+	};
+
+	uintptr_t readPages[PAGE_COUNT];
+	uintptr_t writePages[PAGE_COUNT];
+	//the marks minus the address shifted down, like a direct entry, 0 when the page isn't marked
+	uintptr_t markPages[PAGE_COUNT];
+	Handlers handlers[PAGE_COUNT];
+	uint8_t discard[PAGE_SIZE];
+
+	uint8_t ReadHandled(uint16_t address) const;
+	void WriteHandled(uint16_t address, uint8_t value);
+};
@@ -0,0 +1,138 @@
+#include "Movie.h"
+#include <fstream>
+#include <cstring>
+
+#include "SnapshotFile.h"
+#include "Utilities.h"
+
+void Movie::Start(const CPU& cpu) {
+	start = {};
+	cpu.SaveState(start);
+	memcpy(inputs, start.inputs, sizeof(inputs));
+	events.clear();
+	frameCount = 0;
+	romHash = HashMemory(cpu, 0, ROM_SIZE);
+	endHash = 0;
+	endCycle = 0;
+}
+
+//a value the port already holds changes nothing, so only changes are logged
+void Movie::SetInput(CPU& cpu, size_t index, uint8_t value) {
+	cpu.SetInput(index, value);
+	if (inputs[index] == value) return;
+
+	inputs[index] = value;
+	events.push_back({ frameCount, static_cast<uint8_t>(index), value });
+}
+
+void Movie::RunFrame(CPU& cpu) {
+	cpu.RunFrame();
+	frameCount++;
+}
+
+void Movie::Finish(const CPU& cpu) {
+	endHash = HashState(cpu);
+	endCycle = cpu.GetCycleCount();
+}
+
+bool Movie::Replay(CPU& cpu) const {
+	if (HashMemory(cpu, 0, ROM_SIZE) != romHash) return false;
+
+	cpu.LoadState(start);
+	size_t next = 0;
+	for (uint32_t frame = 0; frame < frameCount; frame++) {
+		for (; next < events.size() && events[next].frame == frame; next++) {
+			cpu.SetInput(events[next].index, events[next].value);
+		}
+		cpu.RunFrame();
+	}
+
+	return cpu.GetCycleCount() == endCycle && HashState(cpu) == endHash;
+}
+
+bool Movie::Save(const std::string& fileName) const {
+	std::vector<uint8_t> snapshot;
+	EncodeSnapshot(start, true, snapshot);
+
+	std::vector<uint8_t> encoded;
+	uint32_t last = 0;
+	for (const Event& event : events) {
+		uint32_t delta = event.frame - last;
+		last = event.frame;
+		while (delta >= 0x80) {
+			encoded.push_back(static_cast<uint8_t>(delta | 0x80));
+			delta >>= 7;
+		}
+		encoded.push_back(static_cast<uint8_t>(delta));
+		encoded.push_back(event.index);
+		encoded.push_back(event.value);
+	}
+
+	Header header = {};
+	header.magic = MOVIE_MAGIC;
+	header.version = MOVIE_VERSION;
+	header.romHash = romHash;
+	header.endHash = endHash;
+	header.endCycle = endCycle;
+	header.frameCount = frameCount;
+	header.eventCount = static_cast<uint32_t>(events.size());
+	header.startSize = static_cast<uint32_t>(snapshot.size());
+	header.eventSize = static_cast<uint32_t>(encoded.size());
+
+	std::ofstream out(fileName, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char*>(snapshot.data()), snapshot.size());
+	out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+	return static_cast<bool>(out);
+}
+
+bool Movie::Load(const std::string& fileName) {
+	std::ifstream in(fileName, std::ios::binary);
+	if (!in) return false;
+
+	Header header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || header.magic != MOVIE_MAGIC || header.version != MOVIE_VERSION) return false;
+
+	std::vector<uint8_t> snapshot(header.startSize);
+	std::vector<uint8_t> encoded(header.eventSize);
+	in.read(reinterpret_cast<char*>(snapshot.data()), snapshot.size());
+	in.read(reinterpret_cast<char*>(encoded.data()), encoded.size());
+	if (!in || !DecodeSnapshot(snapshot.data(), snapshot.size(), start)) return false;
+
+	events.clear();
+	uint32_t frame = 0;
+	size_t i = 0;
+	while (events.size() < header.eventCount) {
+		uint32_t delta = 0;
+		for (int shift = 0; ; shift += 7) {
+			if (i >= encoded.size() || shift > 28) return false;
+			uint8_t byte = encoded[i++];
+			delta |= static_cast<uint32_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) break;
+		}
+		if (i + 2 > encoded.size() || encoded[i] >= sizeof(inputs)) return false;
+
+		frame += delta;
+		events.push_back({ frame, encoded[i], encoded[i + 1] });
+		i += 2;
+	}
+
+	memcpy(inputs, start.inputs, sizeof(inputs));
+	frameCount = header.frameCount;
+	romHash = header.romHash;
+	endHash = header.endHash;
+	endCycle = header.endCycle;
+	return i == encoded.size();
+}
+
+uint64_t Movie::HashMemory(const CPU& cpu, size_t address, size_t size) {
+	return HashBytes(cpu.GetRAM(address), size);
+}
+
+//the snapshot starts zeroed so its padding hashes the same every time
+uint64_t Movie::HashState(const CPU& cpu) {
+	Snapshot snapshot = {};
+	cpu.SaveState(snapshot);
+	return HashBytes(&snapshot, sizeof(snapshot));
+}
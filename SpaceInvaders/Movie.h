@@ -0,0 +1,66 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "CPU.h"
+
+//"SIMV" read as a little-endian word
+#define MOVIE_MAGIC 0x564D4953
+#define MOVIE_VERSION 1
+
+//a recorded session: the machine it started from, every input change keyed by the frame it was made before, and a hash of where it ended
+//frames are run with CPU::RunFrame, so the same inputs land on the same instructions and a replay is exact at any speed
+class Movie {
+public:
+	//starts recording from the machine as it stands, inputs already set are part of the snapshot
+	void Start(const CPU& cpu);
+	//sets the input and logs it, only inputs set through here are recorded
+	void SetInput(CPU& cpu, size_t index, uint8_t value);
+	void RunFrame(CPU& cpu);
+	//ends the recording at the machine's current state
+	void Finish(const CPU& cpu);
+
+	//loads the start state and plays the inputs back as fast as the CPU runs, true if it ends where the recording did
+	//the CPU has to have the recording's ROM loaded
+	bool Replay(CPU& cpu) const;
+
+	bool Save(const std::string& fileName) const;
+	bool Load(const std::string& fileName);
+
+	uint32_t GetFrameCount() const { return frameCount; }
+	size_t GetEventCount() const { return events.size(); }
+
+private:
+	struct Event {
+		uint32_t frame;
+		uint8_t index;
+		uint8_t value;
+	};
+
+	//the file is this header, the start snapshot in the snapshot file format, then the events
+	//each event is the frames since the one before as a LEB128 varint, then the port and value bytes
+	struct Header {
+		uint32_t magic;
+		uint16_t version;
+		uint16_t flags;
+		uint64_t romHash;
+		uint64_t endHash;
+		uint64_t endCycle;
+		uint32_t frameCount;
+		uint32_t eventCount;
+		uint32_t startSize;
+		uint32_t eventSize;
+	};
+
+	Snapshot start = {};
+	std::vector<Event> events;
+	uint8_t inputs[4] = {};
+	uint32_t frameCount = 0;
+	uint64_t romHash = 0;
+	uint64_t endHash = 0;
+	uint64_t endCycle = 0;
+
+	static uint64_t HashMemory(const CPU& cpu, size_t address, size_t size);
+	static uint64_t HashState(const CPU& cpu);
+};
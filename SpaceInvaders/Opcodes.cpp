@@ -0,0 +1,24 @@
+#include "Opcodes.h"
+#include <sstream>
+#include <iomanip>
+
+//only reads as many bytes as the opcode has, immediates print as #$ and addresses as $
+std::string FormatInstruction(const uint8_t* inst) {
+	std::string mnemonic = opcodeTable.entries[inst[0]].mnemonic;
+
+	std::stringstream stream;
+	stream << std::hex << std::uppercase << std::setfill('0');
+
+	size_t operand;
+	if ((operand = mnemonic.find("D16")) != std::string::npos) {
+		stream << mnemonic.substr(0, operand) << "#$" << std::setw(4) << (inst[1] | (inst[2] << 8));
+	} else if ((operand = mnemonic.find("D8")) != std::string::npos) {
+		stream << mnemonic.substr(0, operand) << "#$" << std::setw(2) << static_cast<uint16_t>(inst[1]);
+	} else if ((operand = mnemonic.find("adr")) != std::string::npos) {
+		stream << mnemonic.substr(0, operand) << "$" << std::setw(4) << (inst[1] | (inst[2] << 8));
+	} else {
+		stream << mnemonic;
+	}
+
+	return stream.str();
+}
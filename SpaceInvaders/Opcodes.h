@@ -0,0 +1,320 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+
+#include "Flags.h"
+
+//metadata for every 8080 opcode, shared by the CPU, the JIT, the Recompiler and both disassemblers
+
+//added to conditional CALL and RET when taken
+#define TAKEN_BRANCH_CYCLES 6
+
+//Z, S, P and AC, the flags INR and DCR write
+#define FLAGS_RESULT (FLAG_Z | FLAG_S | FLAG_P | FLAG_AC)
+
+//how an instruction reaches memory, besides fetching its own bytes
+enum OpcodeMemory : uint8_t {
+	MEMORY_NONE,
+	MEMORY_READ,
+	MEMORY_WRITE,
+	//reads and writes back the byte at HL
+	MEMORY_MODIFY,
+	MEMORY_STACK,
+	MEMORY_PORT,
+};
+
+struct OpcodeInfo {
+	//operands are written as D8, D16 or adr, undocumented aliases start with *
+	const char* mnemonic;
+	//bytes, including the opcode itself
+	uint8_t length;
+	//T-states, with takenCycles added when a conditional CALL or RET is taken
+	uint8_t cycles;
+	uint8_t takenCycles;
+	//bits of F, using the FLAG_ masks
+	uint8_t flagsRead;
+	uint8_t flagsWritten;
+	OpcodeMemory memory;
+	//anything that can leave straight-line code ends a block
+	bool endsBlock;
+};
+
+struct OpcodeTable {
+	OpcodeInfo entries[256];
+};
+
+static constexpr OpcodeTable opcodeTable = { {
+		{ "NOP",         1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x00
+		{ "LXI B, D16",  3, 10, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x01
+		{ "STAX B",      1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x02
+		{ "INX B",       1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x03
+		{ "INR B",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x04
+		{ "DCR B",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x05
+		{ "MVI B, D8",   2,  7, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x06
+		{ "RLC",         1,  4, 0,                    0,                   FLAG_CY,     MEMORY_NONE,   false },	//0x07
+		{ "*NOP",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x08
+		{ "DAD B",       1, 10, 0,                    0,                   FLAG_CY,     MEMORY_NONE,   false },	//0x09
+		{ "LDAX B",      1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x0A
+		{ "DCX B",       1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x0B
+		{ "INR C",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x0C
+		{ "DCR C",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x0D
+		{ "MVI C, D8",   2,  7, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x0E
+		{ "RRC",         1,  4, 0,                    0,                   FLAG_CY,     MEMORY_NONE,   false },	//0x0F
+		{ "*NOP",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x10
+		{ "LXI D, D16",  3, 10, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x11
+		{ "STAX D",      1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x12
+		{ "INX D",       1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x13
+		{ "INR D",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x14
+		{ "DCR D",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x15
+		{ "MVI D, D8",   2,  7, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x16
+		{ "RAL",         1,  4, 0,                    FLAG_CY,             FLAG_CY,     MEMORY_NONE,   false },	//0x17
+		{ "*NOP",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x18
+		{ "DAD D",       1, 10, 0,                    0,                   FLAG_CY,     MEMORY_NONE,   false },	//0x19
+		{ "LDAX D",      1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x1A
+		{ "DCX D",       1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x1B
+		{ "INR E",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x1C
+		{ "DCR E",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x1D
+		{ "MVI E, D8",   2,  7, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x1E
+		{ "RAR",         1,  4, 0,                    FLAG_CY,             FLAG_CY,     MEMORY_NONE,   false },	//0x1F
+		{ "*NOP",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x20
+		{ "LXI H, D16",  3, 10, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x21
+		{ "SHLD adr",    3, 16, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x22
+		{ "INX H",       1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x23
+		{ "INR H",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x24
+		{ "DCR H",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x25
+		{ "MVI H, D8",   2,  7, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x26
+		{ "DAA",         1,  4, 0,                    FLAG_AC | FLAG_CY,   FLAG_MASK,   MEMORY_NONE,   false },	//0x27
+		{ "*NOP",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x28
+		{ "DAD H",       1, 10, 0,                    0,                   FLAG_CY,     MEMORY_NONE,   false },	//0x29
+		{ "LHLD adr",    3, 16, 0,                    0,                   0,           MEMORY_READ,   false },	//0x2A
+		{ "DCX H",       1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x2B
+		{ "INR L",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x2C
+		{ "DCR L",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x2D
+		{ "MVI L, D8",   2,  7, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x2E
+		{ "CMA",         1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x2F
+		{ "*NOP",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x30
+		{ "LXI SP, D16", 3, 10, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x31
+		{ "STA adr",     3, 13, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x32
+		{ "INX SP",      1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x33
+		{ "INR M",       1, 10, 0,                    0,                   FLAGS_RESULT, MEMORY_MODIFY, false },	//0x34
+		{ "DCR M",       1, 10, 0,                    0,                   FLAGS_RESULT, MEMORY_MODIFY, false },	//0x35
+		{ "MVI M, D8",   2, 10, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x36
+		{ "STC",         1,  4, 0,                    0,                   FLAG_CY,     MEMORY_NONE,   false },	//0x37
+		{ "*NOP",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x38
+		{ "DAD SP",      1, 10, 0,                    0,                   FLAG_CY,     MEMORY_NONE,   false },	//0x39
+		{ "LDA adr",     3, 13, 0,                    0,                   0,           MEMORY_READ,   false },	//0x3A
+		{ "DCX SP",      1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x3B
+		{ "INR A",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x3C
+		{ "DCR A",       1,  5, 0,                    0,                   FLAGS_RESULT, MEMORY_NONE,   false },	//0x3D
+		{ "MVI A, D8",   2,  7, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x3E
+		{ "CMC",         1,  4, 0,                    FLAG_CY,             FLAG_CY,     MEMORY_NONE,   false },	//0x3F
+		{ "MOV B, B",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x40
+		{ "MOV B, C",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x41
+		{ "MOV B, D",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x42
+		{ "MOV B, E",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x43
+		{ "MOV B, H",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x44
+		{ "MOV B, L",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x45
+		{ "MOV B, M",    1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x46
+		{ "MOV B, A",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x47
+		{ "MOV C, B",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x48
+		{ "MOV C, C",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x49
+		{ "MOV C, D",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x4A
+		{ "MOV C, E",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x4B
+		{ "MOV C, H",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x4C
+		{ "MOV C, L",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x4D
+		{ "MOV C, M",    1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x4E
+		{ "MOV C, A",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x4F
+		{ "MOV D, B",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x50
+		{ "MOV D, C",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x51
+		{ "MOV D, D",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x52
+		{ "MOV D, E",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x53
+		{ "MOV D, H",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x54
+		{ "MOV D, L",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x55
+		{ "MOV D, M",    1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x56
+		{ "MOV D, A",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x57
+		{ "MOV E, B",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x58
+		{ "MOV E, C",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x59
+		{ "MOV E, D",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x5A
+		{ "MOV E, E",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x5B
+		{ "MOV E, H",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x5C
+		{ "MOV E, L",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x5D
+		{ "MOV E, M",    1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x5E
+		{ "MOV E, A",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x5F
+		{ "MOV H, B",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x60
+		{ "MOV H, C",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x61
+		{ "MOV H, D",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x62
+		{ "MOV H, E",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x63
+		{ "MOV H, H",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x64
+		{ "MOV H, L",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x65
+		{ "MOV H, M",    1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x66
+		{ "MOV H, A",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x67
+		{ "MOV L, B",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x68
+		{ "MOV L, C",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x69
+		{ "MOV L, D",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x6A
+		{ "MOV L, E",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x6B
+		{ "MOV L, H",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x6C
+		{ "MOV L, L",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x6D
+		{ "MOV L, M",    1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x6E
+		{ "MOV L, A",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x6F
+		{ "MOV M, B",    1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x70
+		{ "MOV M, C",    1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x71
+		{ "MOV M, D",    1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x72
+		{ "MOV M, E",    1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x73
+		{ "MOV M, H",    1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x74
+		{ "MOV M, L",    1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x75
+		{ "HLT",         1,  7, 0,                    0,                   0,           MEMORY_NONE,   true },	//0x76
+		{ "MOV M, A",    1,  7, 0,                    0,                   0,           MEMORY_WRITE,  false },	//0x77
+		{ "MOV A, B",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x78
+		{ "MOV A, C",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x79
+		{ "MOV A, D",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x7A
+		{ "MOV A, E",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x7B
+		{ "MOV A, H",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x7C
+		{ "MOV A, L",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x7D
+		{ "MOV A, M",    1,  7, 0,                    0,                   0,           MEMORY_READ,   false },	//0x7E
+		{ "MOV A, A",    1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0x7F
+		{ "ADD B",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x80
+		{ "ADD C",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x81
+		{ "ADD D",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x82
+		{ "ADD E",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x83
+		{ "ADD H",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x84
+		{ "ADD L",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x85
+		{ "ADD M",       1,  7, 0,                    0,                   FLAG_MASK,   MEMORY_READ,   false },	//0x86
+		{ "ADD A",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x87
+		{ "ADC B",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x88
+		{ "ADC C",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x89
+		{ "ADC D",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x8A
+		{ "ADC E",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x8B
+		{ "ADC H",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x8C
+		{ "ADC L",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x8D
+		{ "ADC M",       1,  7, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_READ,   false },	//0x8E
+		{ "ADC A",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x8F
+		{ "SUB B",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x90
+		{ "SUB C",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x91
+		{ "SUB D",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x92
+		{ "SUB E",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x93
+		{ "SUB H",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x94
+		{ "SUB L",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x95
+		{ "SUB M",       1,  7, 0,                    0,                   FLAG_MASK,   MEMORY_READ,   false },	//0x96
+		{ "SUB A",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0x97
+		{ "SBB B",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x98
+		{ "SBB C",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x99
+		{ "SBB D",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x9A
+		{ "SBB E",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x9B
+		{ "SBB H",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x9C
+		{ "SBB L",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x9D
+		{ "SBB M",       1,  7, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_READ,   false },	//0x9E
+		{ "SBB A",       1,  4, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0x9F
+		{ "ANA B",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA0
+		{ "ANA C",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA1
+		{ "ANA D",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA2
+		{ "ANA E",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA3
+		{ "ANA H",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA4
+		{ "ANA L",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA5
+		{ "ANA M",       1,  7, 0,                    0,                   FLAG_MASK,   MEMORY_READ,   false },	//0xA6
+		{ "ANA A",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA7
+		{ "XRA B",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA8
+		{ "XRA C",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xA9
+		{ "XRA D",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xAA
+		{ "XRA E",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xAB
+		{ "XRA H",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xAC
+		{ "XRA L",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xAD
+		{ "XRA M",       1,  7, 0,                    0,                   FLAG_MASK,   MEMORY_READ,   false },	//0xAE
+		{ "XRA A",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xAF
+		{ "ORA B",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB0
+		{ "ORA C",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB1
+		{ "ORA D",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB2
+		{ "ORA E",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB3
+		{ "ORA H",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB4
+		{ "ORA L",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB5
+		{ "ORA M",       1,  7, 0,                    0,                   FLAG_MASK,   MEMORY_READ,   false },	//0xB6
+		{ "ORA A",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB7
+		{ "CMP B",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB8
+		{ "CMP C",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xB9
+		{ "CMP D",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xBA
+		{ "CMP E",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xBB
+		{ "CMP H",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xBC
+		{ "CMP L",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xBD
+		{ "CMP M",       1,  7, 0,                    0,                   FLAG_MASK,   MEMORY_READ,   false },	//0xBE
+		{ "CMP A",       1,  4, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xBF
+		{ "RNZ",         1,  5, TAKEN_BRANCH_CYCLES,  FLAG_Z,              0,           MEMORY_STACK,  true },	//0xC0
+		{ "POP B",       1, 10, 0,                    0,                   0,           MEMORY_STACK,  false },	//0xC1
+		{ "JNZ adr",     3, 10, 0,                    FLAG_Z,              0,           MEMORY_NONE,   true },	//0xC2
+		{ "JMP adr",     3, 10, 0,                    0,                   0,           MEMORY_NONE,   true },	//0xC3
+		{ "CNZ adr",     3, 11, TAKEN_BRANCH_CYCLES,  FLAG_Z,              0,           MEMORY_STACK,  true },	//0xC4
+		{ "PUSH B",      1, 11, 0,                    0,                   0,           MEMORY_STACK,  false },	//0xC5
+		{ "ADI D8",      2,  7, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xC6
+		{ "RST 0",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xC7
+		{ "RZ",          1,  5, TAKEN_BRANCH_CYCLES,  FLAG_Z,              0,           MEMORY_STACK,  true },	//0xC8
+		{ "RET",         1, 10, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xC9
+		{ "JZ adr",      3, 10, 0,                    FLAG_Z,              0,           MEMORY_NONE,   true },	//0xCA
+		{ "*JMP adr",    3, 10, 0,                    0,                   0,           MEMORY_NONE,   true },	//0xCB
+		{ "CZ adr",      3, 11, TAKEN_BRANCH_CYCLES,  FLAG_Z,              0,           MEMORY_STACK,  true },	//0xCC
+		{ "CALL adr",    3, 17, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xCD
+		{ "ACI D8",      2,  7, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0xCE
+		{ "RST 1",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xCF
+		{ "RNC",         1,  5, TAKEN_BRANCH_CYCLES,  FLAG_CY,             0,           MEMORY_STACK,  true },	//0xD0
+		{ "POP D",       1, 10, 0,                    0,                   0,           MEMORY_STACK,  false },	//0xD1
+		{ "JNC adr",     3, 10, 0,                    FLAG_CY,             0,           MEMORY_NONE,   true },	//0xD2
+		{ "OUT D8",      2, 10, 0,                    0,                   0,           MEMORY_PORT,   false },	//0xD3
+		{ "CNC adr",     3, 11, TAKEN_BRANCH_CYCLES,  FLAG_CY,             0,           MEMORY_STACK,  true },	//0xD4
+		{ "PUSH D",      1, 11, 0,                    0,                   0,           MEMORY_STACK,  false },	//0xD5
+		{ "SUI D8",      2,  7, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xD6
+		{ "RST 2",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xD7
+		{ "RC",          1,  5, TAKEN_BRANCH_CYCLES,  FLAG_CY,             0,           MEMORY_STACK,  true },	//0xD8
+		{ "*RET",        1, 10, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xD9
+		{ "JC adr",      3, 10, 0,                    FLAG_CY,             0,           MEMORY_NONE,   true },	//0xDA
+		{ "IN D8",       2, 10, 0,                    0,                   0,           MEMORY_PORT,   false },	//0xDB
+		{ "CC adr",      3, 11, TAKEN_BRANCH_CYCLES,  FLAG_CY,             0,           MEMORY_STACK,  true },	//0xDC
+		{ "*CALL adr",   3, 17, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xDD
+		{ "SBI D8",      2,  7, 0,                    FLAG_CY,             FLAG_MASK,   MEMORY_NONE,   false },	//0xDE
+		{ "RST 3",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xDF
+		{ "RPO",         1,  5, TAKEN_BRANCH_CYCLES,  FLAG_P,              0,           MEMORY_STACK,  true },	//0xE0
+		{ "POP H",       1, 10, 0,                    0,                   0,           MEMORY_STACK,  false },	//0xE1
+		{ "JPO adr",     3, 10, 0,                    FLAG_P,              0,           MEMORY_NONE,   true },	//0xE2
+		{ "XTHL",        1, 18, 0,                    0,                   0,           MEMORY_STACK,  false },	//0xE3
+		{ "CPO adr",     3, 11, TAKEN_BRANCH_CYCLES,  FLAG_P,              0,           MEMORY_STACK,  true },	//0xE4
+		{ "PUSH H",      1, 11, 0,                    0,                   0,           MEMORY_STACK,  false },	//0xE5
+		{ "ANI D8",      2,  7, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xE6
+		{ "RST 4",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xE7
+		{ "RPE",         1,  5, TAKEN_BRANCH_CYCLES,  FLAG_P,              0,           MEMORY_STACK,  true },	//0xE8
+		{ "PCHL",        1,  5, 0,                    0,                   0,           MEMORY_NONE,   true },	//0xE9
+		{ "JPE adr",     3, 10, 0,                    FLAG_P,              0,           MEMORY_NONE,   true },	//0xEA
+		{ "XCHG",        1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0xEB
+		{ "CPE adr",     3, 11, TAKEN_BRANCH_CYCLES,  FLAG_P,              0,           MEMORY_STACK,  true },	//0xEC
+		{ "*CALL adr",   3, 17, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xED
+		{ "XRI D8",      2,  7, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xEE
+		{ "RST 5",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xEF
+		{ "RP",          1,  5, TAKEN_BRANCH_CYCLES,  FLAG_S,              0,           MEMORY_STACK,  true },	//0xF0
+		{ "POP PSW",     1, 10, 0,                    0,                   FLAG_MASK,   MEMORY_STACK,  false },	//0xF1
+		{ "JP adr",      3, 10, 0,                    FLAG_S,              0,           MEMORY_NONE,   true },	//0xF2
+		{ "DI",          1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0xF3
+		{ "CP adr",      3, 11, TAKEN_BRANCH_CYCLES,  FLAG_S,              0,           MEMORY_STACK,  true },	//0xF4
+		{ "PUSH PSW",    1, 11, 0,                    FLAG_MASK,           0,           MEMORY_STACK,  false },	//0xF5
+		{ "ORI D8",      2,  7, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xF6
+		{ "RST 6",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xF7
+		{ "RM",          1,  5, TAKEN_BRANCH_CYCLES,  FLAG_S,              0,           MEMORY_STACK,  true },	//0xF8
+		{ "SPHL",        1,  5, 0,                    0,                   0,           MEMORY_NONE,   false },	//0xF9
+		{ "JM adr",      3, 10, 0,                    FLAG_S,              0,           MEMORY_NONE,   true },	//0xFA
+		{ "EI",          1,  4, 0,                    0,                   0,           MEMORY_NONE,   false },	//0xFB
+		{ "CM adr",      3, 11, TAKEN_BRANCH_CYCLES,  FLAG_S,              0,           MEMORY_STACK,  true },	//0xFC
+		{ "*CALL adr",   3, 17, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xFD
+		{ "CPI D8",      2,  7, 0,                    0,                   FLAG_MASK,   MEMORY_NONE,   false },	//0xFE
+		{ "RST 7",       1, 11, 0,                    0,                   0,           MEMORY_STACK,  true },	//0xFF
+} };
+
+//one byte of each entry, packed so the interpreter's per-instruction lookups stay in a few cache lines
+struct OpcodeFieldTable {
+	uint8_t entries[256];
+
+	constexpr OpcodeFieldTable(uint8_t OpcodeInfo::* field) : entries() {
+		for (int i = 0; i < 256; i++) {
+			entries[i] = opcodeTable.entries[i].*field;
+		}
+	}
+};
+
+static constexpr OpcodeFieldTable lengthTable = OpcodeFieldTable(&OpcodeInfo::length);
+static constexpr OpcodeFieldTable cycleTable = OpcodeFieldTable(&OpcodeInfo::cycles);
+
+//the mnemonic with its operand filled in from the bytes after the opcode
+std::string FormatInstruction(const uint8_t* inst);
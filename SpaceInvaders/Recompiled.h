@@ -0,0 +1,208 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#include "CPU.h"
+#include "Flags.h"
+#include "Utilities.h"
+
+//support code for Recompiled.cpp, which Recompiler generates from invaders.rom
+
+//so a build only runs its recompiled code against the ROM it was generated from
+inline uint64_t HashROM(const uint8_t* data, size_t size) {
+	return HashBytes(data, size);
+}
+
+//the guest registers, copied into a local for the length of CPU::RunRecompiled so the compiler can keep them in host registers
+//every operation matches its handler in CPU::Execute, F uses the State layout and the flags are always lazy, Store materializes them for eager builds
+struct RecompiledState {
+	uint8_t a;
+	uint8_t f;
+	uint8_t b;
+	uint8_t c;
+	uint8_t d;
+	uint8_t e;
+	uint8_t h;
+	uint8_t l;
+	uint16_t sp;
+	uint8_t result;
+	uint8_t aux;
+	uint8_t pending;
+	MemoryBus* bus;
+
+	FORCE_INLINE void Load(State& state, MemoryBus& memoryBus) {
+		a = state.a();
+		f = state.f();
+		b = state.b();
+		c = state.c();
+		d = state.d();
+		e = state.e();
+		h = state.h();
+		l = state.l();
+		sp = state.sp;
+		result = state.lazyFlags.result;
+		aux = state.lazyFlags.aux;
+		pending = state.lazyFlags.pending;
+		bus = &memoryBus;
+	}
+
+	FORCE_INLINE void Store(State& state) {
+#if !CPU_LAZY_FLAGS
+		MaterializeFlags();
+#endif
+		state.a() = a;
+		state.f() = f;
+		state.b() = b;
+		state.c() = c;
+		state.d() = d;
+		state.e() = e;
+		state.h() = h;
+		state.l() = l;
+		state.sp = sp;
+		state.lazyFlags.result = result;
+		state.lazyFlags.aux = aux;
+		state.lazyFlags.pending = pending;
+	}
+
+	uint16_t BC() const { return static_cast<uint16_t>((b << 8) | c); }
+	uint16_t DE() const { return static_cast<uint16_t>((d << 8) | e); }
+	uint16_t HL() const { return static_cast<uint16_t>((h << 8) | l); }
+	void SetBC(uint16_t value) { b = static_cast<uint8_t>(value >> 8); c = static_cast<uint8_t>(value); }
+	void SetDE(uint16_t value) { d = static_cast<uint8_t>(value >> 8); e = static_cast<uint8_t>(value); }
+	void SetHL(uint16_t value) { h = static_cast<uint8_t>(value >> 8); l = static_cast<uint8_t>(value); }
+	uint8_t Read(uint16_t address) const { return bus->Read(address); }
+	void Write(uint16_t address, uint8_t value) { bus->Write(address, value); }
+	uint8_t M() const { return Read(HL()); }
+	void SetM(uint8_t value) { Write(HL(), value); }
+
+	void SetResultFlags(uint8_t value, uint8_t auxValue) {
+		result = value;
+		aux = auxValue;
+		pending = 1;
+	}
+
+	void MaterializeFlags() {
+		if (pending) {
+			f = static_cast<uint8_t>((f & FLAG_CY) | FLAG_ONE | resultFlagsTable.entries[result] | (aux & FLAG_AC));
+			pending = 0;
+		}
+	}
+
+	uint8_t Zero() const { return pending ? result == 0 : (f >> 6) & 1; }
+	uint8_t Sign() const { return pending ? result >> 7 : f >> 7; }
+	uint8_t Parity() const { return ((pending ? resultFlagsTable.entries[result] : f) >> 2) & 1; }
+	uint8_t AuxCarry() const { return ((pending ? aux : f) >> 4) & 1; }
+	uint8_t Carry() const { return f & FLAG_CY; }
+	void SetCarry(uint8_t carry) { f = static_cast<uint8_t>((f & ~FLAG_CY) | carry); }
+
+	uint8_t AddWithCarry(uint8_t x, uint8_t y, uint8_t carry) {
+		uint16_t sum = static_cast<uint16_t>(x) + static_cast<uint16_t>(y) + carry;
+		SetCarry(static_cast<uint8_t>(sum >> 8));
+		SetResultFlags(static_cast<uint8_t>(sum), static_cast<uint8_t>(x ^ y ^ sum));
+		return static_cast<uint8_t>(sum);
+	}
+
+	uint8_t SubtractWithBorrow(uint8_t x, uint8_t y, uint8_t borrow) {
+		uint16_t difference = static_cast<uint16_t>(x) - static_cast<uint16_t>(y) - borrow;
+		SetCarry((difference >> 8) & 1);
+		SetResultFlags(static_cast<uint8_t>(difference), static_cast<uint8_t>(~(x ^ y ^ difference)));
+		return static_cast<uint8_t>(difference);
+	}
+
+	void ADD(uint8_t value) { a = AddWithCarry(a, value, 0); }
+	void ADC(uint8_t value) { a = AddWithCarry(a, value, Carry()); }
+	void SUB(uint8_t value) { a = SubtractWithBorrow(a, value, 0); }
+	void SBB(uint8_t value) { a = SubtractWithBorrow(a, value, Carry()); }
+	void CMP(uint8_t value) { SubtractWithBorrow(a, value, 0); }
+
+	void ANA(uint8_t value) {
+		uint8_t x = a;
+		a &= value;
+		SetCarry(0);
+		SetResultFlags(a, static_cast<uint8_t>((x | value) << 1));
+	}
+
+	void XRA(uint8_t value) {
+		a ^= value;
+		SetCarry(0);
+		SetResultFlags(a, 0);
+	}
+
+	void ORA(uint8_t value) {
+		a |= value;
+		SetCarry(0);
+		SetResultFlags(a, 0);
+	}
+
+	uint8_t INR(uint8_t value) {
+		const IncDecResult& entry = incrementTable.entries[value];
+		SetResultFlags(entry.result, entry.aux);
+		return entry.result;
+	}
+
+	uint8_t DCR(uint8_t value) {
+		const IncDecResult& entry = decrementTable.entries[value];
+		SetResultFlags(entry.result, entry.aux);
+		return entry.result;
+	}
+
+	void DAD(uint16_t value) {
+		uint32_t sum = static_cast<uint32_t>(HL()) + value;
+		SetCarry(sum > 0xFFFF);
+		SetHL(static_cast<uint16_t>(sum));
+	}
+
+	void DAA() {
+		uint8_t correction = 0;
+		uint8_t carry = Carry();
+		uint8_t lsb = a & 0xF;
+		uint8_t msb = a >> 4;
+		if (AuxCarry() || lsb > 9) {
+			correction |= 0x06;
+		}
+		if (carry || msb > 9 || (msb >= 9 && lsb > 9)) {
+			correction |= 0x60;
+			carry = 1;
+		}
+		a = AddWithCarry(a, correction, 0);
+		SetCarry(carry);
+	}
+
+	void Push(uint16_t value) {
+		sp -= 2;
+		bus->WriteWord(sp, value);
+	}
+
+	uint16_t Pop() {
+		uint16_t value = bus->ReadWord(sp);
+		sp += 2;
+		return value;
+	}
+
+	void PushPSW() {
+		MaterializeFlags();
+		Push(static_cast<uint16_t>((a << 8) | f));
+	}
+
+	void PopPSW() {
+		uint16_t value = Pop();
+		a = static_cast<uint8_t>(value >> 8);
+		f = static_cast<uint8_t>((value & FLAG_MASK) | FLAG_ONE);
+		pending = 0;
+	}
+
+	void XTHL() {
+		uint16_t value = HL();
+		SetHL(Pop());
+		Push(value);
+	}
+
+	void XCHG() {
+		uint8_t high = h;
+		uint8_t low = l;
+		h = d;
+		l = e;
+		d = high;
+		e = low;
+	}
+};
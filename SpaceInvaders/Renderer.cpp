@@ -3,6 +3,7 @@
 #include <set>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -81,12 +82,14 @@ Renderer::~Renderer() {
 	glfwTerminate();
 }
 
-void Renderer::Render() {
+void Renderer::Render(const RowSet& dirtyRows) {
 	uint32_t index;
 	vkAcquireNextImageKHR(device, swapchain, ~0ull, acquireImageSemaphore, VK_NULL_HANDLE, &index);
 	vkWaitForFences(device, 1, &fences[index], true, ~0ull);
 	vkResetFences(device, 1, &fences[index]);
 
+	RecordCommandBuffer(index, dirtyRows);
+
 	VkPipelineStageFlags waitMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
 	VkSubmitInfo submitInfo = {};
@@ -739,6 +742,8 @@ void Renderer::CreateCommandPool() {
 	VkCommandPoolCreateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	info.queueFamilyIndex = queueInfo.graphicsFamily;
+	//the frame command buffers are rerecorded with that frame's dirty rows
+	info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	VK_CHECK(vkCreateCommandPool(device, &info, nullptr, &commandPool), "Failed to create command pool");
 }
@@ -751,59 +756,74 @@ void Renderer::CreateCommandBuffers() {
 
 	commandBuffers.resize(swapchainImageViews.size());
 	VK_CHECK(vkAllocateCommandBuffers(device, &info, commandBuffers.data()), "Failed to create command buffer");
-
-	for (uint32_t i = 0; i < commandBuffers.size(); i++) {
-		RecordCommandBuffer(i);
-	}
 }
 
-void Renderer::RecordCommandBuffer(uint32_t index) {
+void Renderer::RecordCommandBuffer(uint32_t index, const RowSet& dirtyRows) {
 	VkCommandBuffer& commandBuffer = commandBuffers[index];
 
 	VkCommandBufferBeginInfo beginInfo = {};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 	vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-	VkImageMemoryBarrier barrier = {};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.image = texture;
-	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-	vkCmdPipelineBarrier(commandBuffer,
-		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier);
-
-	VkBufferImageCopy copy = {};
-	copy.imageExtent = { IMAGE_WIDTH, IMAGE_HEIGHT, 1 };
-	copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	copy.imageSubresource.baseArrayLayer = 0;
-	copy.imageSubresource.layerCount = 1;
-
-	vkCmdCopyBufferToImage(commandBuffer, vramBuffer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
-
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-	vkCmdPipelineBarrier(commandBuffer,
-		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier);
+	//one copy per run of consecutive dirty rows
+	std::vector<VkBufferImageCopy> copies;
+	for (uint32_t row = 0; row < IMAGE_HEIGHT; row++) {
+		if (!dirtyRows[row]) continue;
+		uint32_t end = row + 1;
+		while (end < IMAGE_HEIGHT && dirtyRows[end]) end++;
+
+		VkBufferImageCopy copy = {};
+		copy.bufferOffset = row * IMAGE_WIDTH * 4;
+		copy.imageOffset = { 0, static_cast<int32_t>(row), 0 };
+		copy.imageExtent = { IMAGE_WIDTH, end - row, 1 };
+		copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.imageSubresource.baseArrayLayer = 0;
+		copy.imageSubresource.layerCount = 1;
+		copies.push_back(copy);
+
+		row = end;
+	}
+
+	if (!copies.empty()) {
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.image = texture;
+		//rows that are not copied keep their contents, except before the first upload
+		barrier.oldLayout = textureUploaded ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		vkCmdCopyBufferToImage(commandBuffer, vramBuffer, texture, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.size()), copies.data());
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+			0, nullptr,
+			0, nullptr,
+			1, &barrier);
+
+		textureUploaded = true;
+	}
 
 	VkClearValue clear = {};
 	clear.color.float32[0] = 0.125f;
@@ -4,7 +4,7 @@
 #include <vector>
 #include <memory>
 
-#include "Utilities.h"
+#include "VulkanUtilities.h"
 #include "Display.h"
 #include "Allocator.h"
 
@@ -16,7 +16,8 @@ public:
 	GLFWwindow* GetWindow() const { return window; }
 	void* GetVRAMMapping() const { return vramMapping; }
 
-	void Render();
+	//uploads only the rows set in dirtyRows from the VRAM mapping
+	void Render(const RowSet& dirtyRows);
 
 private:
 	struct QueueInfo {
@@ -56,6 +57,7 @@ private:
 	void* vramMapping;
 	VkBuffer vertexBuffer;
 	VkImage texture;
+	bool textureUploaded = false;
 	VkImageView imageView;
 	VkSampler sampler;
 	VkDescriptorSetLayout descriptorSetLayout;
@@ -98,7 +100,7 @@ private:
 	void CreatePipeline();
 	void CreateCommandPool();
 	void CreateCommandBuffers();
-	void RecordCommandBuffer(uint32_t index);
+	void RecordCommandBuffer(uint32_t index, const RowSet& dirtyRows);
 	VkCommandBuffer GetSingleUseCommandBuffer();
 	void SubmitSingleUseCommandBuffer(VkCommandBuffer commandBuffer);
 	void CopyStaging(size_t size, void* srcMemory, VkBuffer dstBuffer);
@@ -0,0 +1,227 @@
+#include "Rewind.h"
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+//a changed span is a 2 byte count of unchanged bytes to skip, a 2 byte count of changed bytes, then the changed bytes XORed
+#define SPAN_HEADER 4
+//a span ends at this many unchanged bytes in a row, which cost no more to skip than to copy
+#define MIN_SKIP SPAN_HEADER
+//the first span can skip nothing, every later one skips at least MIN_SKIP bytes to pay for its header
+#define MAX_ENCODED (sizeof(Snapshot) + SPAN_HEADER)
+
+static_assert(sizeof(Snapshot) <= 0xFFFF, "span counts are 16 bits");
+
+//keyframes are encoded against all zeroes
+static const Snapshot zeroSnapshot = {};
+
+Rewind::Rewind(size_t capacity) : capacity(capacity) {
+	size_t fixed = 2 * sizeof(Snapshot) + 2 * MAX_ENCODED;
+	size_t frameCount = capacity / REWIND_MIN_FRAME_BYTES;
+	size_t indexBytes = frameCount * sizeof(Frame);
+	if (capacity < fixed + indexBytes + 2 * MAX_ENCODED) {
+		throw std::runtime_error("Rewind capacity is too small to hold a keyframe");
+	}
+
+	data.resize(capacity - fixed - indexBytes);
+	frames.resize(frameCount);
+	encoded.resize(2 * MAX_ENCODED);
+}
+
+//the delta is always encoded, and the keyframe when one is due, before anything is evicted
+void Rewind::Push(const CPU& cpu) {
+	cpu.SaveState(incoming);
+
+	const uint8_t* from = reinterpret_cast<const uint8_t*>(&current);
+	const uint8_t* to = reinterpret_cast<const uint8_t*>(&incoming);
+	size_t deltaSize = Encode(from, to, encoded.data());
+	size_t keySize = 0;
+	if (sinceKeyframe == 0) {
+		keySize = Encode(reinterpret_cast<const uint8_t*>(&zeroSnapshot), to, encoded.data() + deltaSize);
+	}
+
+	size_t size = deltaSize + keySize;
+	if (count == frames.size()) DropOldest();
+	size_t offset = Allocate(size);
+	memcpy(&data[offset], encoded.data(), size);
+
+	Frame& frame = At(count++);
+	frame.offset = static_cast<uint32_t>(offset);
+	frame.deltaSize = static_cast<uint16_t>(deltaSize);
+	frame.keySize = static_cast<uint16_t>(keySize);
+	head = offset + size;
+	used += size;
+
+	current = incoming;
+	sinceKeyframe = (sinceKeyframe + 1) % REWIND_KEYFRAME_INTERVAL;
+}
+
+//starts from the newest frame or the keyframe nearest the target, whichever has fewer deltas to apply
+bool Rewind::Seek(CPU& cpu, size_t framesBack) {
+	if (framesBack >= count) return false;
+	size_t target = count - 1 - framesBack;
+
+	size_t best = framesBack;
+	size_t after = count;
+	size_t before = count;
+	for (size_t i = target; i < count && i - target < best; i++) {
+		if (At(i).keySize) {
+			after = i;
+			best = i - target;
+			break;
+		}
+	}
+	for (size_t i = target + 1; i-- > 0 && target - i < best;) {
+		if (At(i).keySize) {
+			before = i;
+			best = target - i;
+			break;
+		}
+	}
+
+	if (before < count) {
+		LoadKeyframe(before);
+		for (size_t i = before + 1; i <= target; i++) ApplyDelta(i);
+	} else {
+		size_t start = count - 1;
+		if (after < count) {
+			LoadKeyframe(after);
+			start = after;
+		}
+		for (size_t i = start; i > target; i--) ApplyDelta(i);
+	}
+
+	for (size_t i = target + 1; i < count; i++) {
+		used -= At(i).deltaSize + At(i).keySize;
+	}
+	count = target + 1;
+	const Frame& newest = At(target);
+	head = newest.offset + newest.deltaSize + newest.keySize;
+
+	//counts the newest keyframe itself, as Push does, and makes the next push a keyframe if none is left
+	sinceKeyframe = 0;
+	for (size_t i = count; i-- > 0;) {
+		if (At(i).keySize) {
+			sinceKeyframe = (count - i) % REWIND_KEYFRAME_INTERVAL;
+			break;
+		}
+	}
+
+	cpu.LoadState(current);
+	return true;
+}
+
+void Rewind::Clear() {
+	first = 0;
+	count = 0;
+	head = 0;
+	used = 0;
+	sinceKeyframe = 0;
+}
+
+size_t Rewind::GetNewestBytes() const {
+	if (count == 0) return 0;
+	const Frame& newest = frames[(first + count - 1) % frames.size()];
+	return newest.deltaSize + newest.keySize;
+}
+
+//frames sit in data in push order, wrapping to the start when the end is too short
+//so the free space is from head to the oldest frame, or from head to the end and then from the start to the oldest frame
+size_t Rewind::Allocate(size_t size) {
+	while (true) {
+		if (count == 0) {
+			head = 0;
+			return 0;
+		}
+
+		size_t tail = At(0).offset;
+		if (head > tail) {
+			if (data.size() - head >= size) return head;
+			if (tail >= size) return 0;
+		} else if (tail - head >= size) {
+			return head;
+		}
+
+		DropOldest();
+	}
+}
+
+//the frame after the oldest only loses the base its delta applies to, which stepping back never reaches
+void Rewind::DropOldest() {
+	const Frame& oldest = At(0);
+	used -= oldest.deltaSize + oldest.keySize;
+	first = (first + 1) % frames.size();
+	count--;
+}
+
+void Rewind::LoadKeyframe(size_t index) {
+	const Frame& frame = At(index);
+	current = zeroSnapshot;
+	Apply(&data[frame.offset + frame.deltaSize], frame.keySize, reinterpret_cast<uint8_t*>(&current));
+}
+
+//takes current from the frame before index to index, or back again
+void Rewind::ApplyDelta(size_t index) {
+	const Frame& frame = At(index);
+	Apply(&data[frame.offset], frame.deltaSize, reinterpret_cast<uint8_t*>(&current));
+}
+
+size_t Rewind::Encode(const uint8_t* from, const uint8_t* to, uint8_t* out) {
+	const size_t size = sizeof(Snapshot);
+	size_t length = 0;
+	size_t last = 0;
+	size_t i = 0;
+
+	while (i < size) {
+		//most of RAM is unchanged, so compare a word at a time until something differs
+		while (i + 8 <= size) {
+			uint64_t a;
+			uint64_t b;
+			memcpy(&a, from + i, 8);
+			memcpy(&b, to + i, 8);
+			if (a != b) break;
+			i += 8;
+		}
+		while (i < size && from[i] == to[i]) i++;
+		if (i == size) break;
+
+		size_t start = i;
+		size_t same = 0;
+		while (i < size && same < MIN_SKIP) {
+			same = from[i] == to[i] ? same + 1 : 0;
+			i++;
+		}
+		size_t end = i - same;
+
+		uint16_t skip = static_cast<uint16_t>(start - last);
+		uint16_t changed = static_cast<uint16_t>(end - start);
+		memcpy(out + length, &skip, 2);
+		memcpy(out + length + 2, &changed, 2);
+		length += SPAN_HEADER;
+		for (size_t j = start; j < end; j++) {
+			out[length++] = from[j] ^ to[j];
+		}
+		last = end;
+	}
+
+	return length;
+}
+
+void Rewind::Apply(const uint8_t* delta, size_t size, uint8_t* target) {
+	size_t position = 0;
+
+	for (size_t i = 0; i < size;) {
+		uint16_t skip;
+		uint16_t changed;
+		memcpy(&skip, delta + i, 2);
+		memcpy(&changed, delta + i + 2, 2);
+		i += SPAN_HEADER;
+		position += skip;
+
+		for (size_t j = 0; j < changed; j++) {
+			target[position + j] ^= delta[i + j];
+		}
+		i += changed;
+		position += changed;
+	}
+}
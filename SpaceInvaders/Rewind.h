@@ -0,0 +1,64 @@
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+#include "CPU.h"
+
+//frames between full snapshots, which bounds how many deltas a Seek has to apply
+#define REWIND_KEYFRAME_INTERVAL 120
+//the index has an entry for every this many bytes of the cap, so a paused game's tiny deltas can't fill it early
+#define REWIND_MIN_FRAME_BYTES 64
+
+//per-frame history of a CPU, each frame kept as the bytes that changed since the frame before, XORed and run-length encoded
+//a XOR delta undoes itself, so stepping back applies the newest one to the current snapshot
+//every REWIND_KEYFRAME_INTERVAL frames a full snapshot is kept as well, so a long Seek starts from whichever is nearer
+//memory is all allocated up front, a push that would go over the cap drops the oldest frames
+class Rewind {
+public:
+	//capacity in bytes, the working snapshots and index included
+	Rewind(size_t capacity);
+
+	void Push(const CPU& cpu);
+	//loads the frame framesBack pushes before the newest and forgets the ones after it, false if history is shorter
+	//VRAM changes behind the bus, so a Display needs Invalidate afterwards
+	bool Seek(CPU& cpu, size_t framesBack);
+	bool StepBack(CPU& cpu) { return Seek(cpu, 1); }
+	void Clear();
+
+	size_t GetFrameCount() const { return count; }
+	size_t GetCapacity() const { return capacity; }
+	//bytes of deltas and keyframes held for the frames in the history
+	size_t GetUsedBytes() const { return used; }
+	//bytes the newest frame holds, its delta and any keyframe
+	size_t GetNewestBytes() const;
+
+private:
+	struct Frame {
+		uint32_t offset;
+		uint16_t deltaSize;
+		//the keyframe follows the delta, 0 when there is none
+		uint16_t keySize;
+	};
+
+	size_t capacity;
+	std::vector<uint8_t> data;
+	std::vector<Frame> frames;
+	std::vector<uint8_t> encoded;
+	size_t first = 0;
+	size_t count = 0;
+	size_t head = 0;
+	size_t used = 0;
+	size_t sinceKeyframe = 0;
+	//the newest frame in full, and the one being pushed
+	Snapshot current = {};
+	Snapshot incoming = {};
+
+	Frame& At(size_t index) { return frames[(first + index) % frames.size()]; }
+	size_t Allocate(size_t size);
+	void DropOldest();
+	void LoadKeyframe(size_t index);
+	void ApplyDelta(size_t index);
+
+	static size_t Encode(const uint8_t* from, const uint8_t* to, uint8_t* out);
+	static void Apply(const uint8_t* delta, size_t size, uint8_t* target);
+};
@@ -0,0 +1,36 @@
+#include "RunAhead.h"
+#include <cstring>
+
+RunAhead::RunAhead(CPU& cpu, Display& display, size_t frames) : cpu(cpu), display(display), frames(frames) {
+}
+
+//loading puts back the VRAM the frames ahead wrote, so the rows where that differs from the real frame are converted again next frame
+//only rows written since the last conversion can differ, and the saved RAM still holds the real frame's copy to compare with
+void RunAhead::RunFrame(size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		cpu.RunFrame();
+	}
+	if (frames == 0) {
+		display.ConvertImage();
+		return;
+	}
+
+	cpu.SaveState(saved);
+	for (size_t i = 0; i < frames; i++) {
+		cpu.RunFrame();
+	}
+	display.ConvertImage();
+
+	const RowSet& converted = display.GetChangedRows();
+	const uint8_t* real = saved.ram + VRAM_ADDR - ROM_SIZE;
+	const uint8_t* ahead = static_cast<const uint8_t*>(cpu.GetRAM(VRAM_ADDR));
+	RowSet restored;
+	for (size_t row = 0; row < IMAGE_HEIGHT; row++) {
+		if (converted[row] && memcmp(real + row * ROW_BYTES, ahead + row * ROW_BYTES, ROW_BYTES) != 0) {
+			restored.set(row);
+		}
+	}
+
+	cpu.LoadState(saved);
+	display.Invalidate(restored);
+}
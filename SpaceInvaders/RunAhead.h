@@ -0,0 +1,25 @@
+#pragma once
+#include <stddef.h>
+
+#include "CPU.h"
+#include "Display.h"
+
+//the most frames the front ends will run ahead, the game reads input in its interrupt handlers so 1 or 2 hides its own lag
+#define MAX_RUN_AHEAD_FRAMES 4
+
+//hides frames of input lag by showing where the machine will be a few frames from now with the current input
+//each frame runs for real, is saved, runs on ahead, has its image converted and is then loaded back
+class RunAhead {
+public:
+	RunAhead(CPU& cpu, Display& display, size_t frames);
+
+	//runs count real frames and leaves the display converted to the frame that is frames further on
+	void RunFrame(size_t count = 1);
+	size_t GetFrames() const { return frames; }
+
+private:
+	CPU& cpu;
+	Display& display;
+	size_t frames;
+	Snapshot saved = {};
+};
@@ -0,0 +1,186 @@
+#include "SnapshotFile.h"
+#include <fstream>
+#include <cstring>
+
+//a control byte below 0x80 is followed by that many plus one literal bytes
+//from 0x80 up it is followed by one byte repeated MIN_RUN more times than the low 7 bits say
+#define MIN_RUN 3
+#define MAX_RUN (0x7F + MIN_RUN)
+#define MAX_LITERALS 0x80
+
+static void Compress(const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+	size_t literals = 0;
+	size_t i = 0;
+
+	while (i < size) {
+		size_t run = 1;
+		while (i + run < size && run < MAX_RUN && data[i + run] == data[i]) run++;
+
+		if (run >= MIN_RUN) {
+			out.push_back(static_cast<uint8_t>(0x80 | (run - MIN_RUN)));
+			out.push_back(data[i]);
+			i += run;
+			literals = 0;
+			continue;
+		}
+
+		//extend the open literal span, its control byte counts one less than it holds
+		if (literals == 0 || literals == MAX_LITERALS) {
+			out.push_back(0);
+			literals = 0;
+		}
+		out.push_back(data[i]);
+		out[out.size() - literals - 2] = static_cast<uint8_t>(literals);
+		literals++;
+		i++;
+	}
+}
+
+static bool Decompress(const uint8_t* data, size_t size, uint8_t* out, size_t outSize) {
+	size_t o = 0;
+	size_t i = 0;
+
+	while (i < size) {
+		uint8_t control = data[i++];
+		if (control & 0x80) {
+			size_t run = (control & 0x7F) + MIN_RUN;
+			if (i >= size || o + run > outSize) return false;
+			memset(out + o, data[i++], run);
+			o += run;
+		} else {
+			size_t count = control + 1;
+			if (i + count > size || o + count > outSize) return false;
+			memcpy(out + o, data + i, count);
+			i += count;
+			o += count;
+		}
+	}
+
+	return o == outSize;
+}
+
+void EncodeSnapshot(const Snapshot& snapshot, bool compress, std::vector<uint8_t>& file) {
+	SnapshotHeader header = {};
+	header.magic = SNAPSHOT_MAGIC;
+	header.version = SNAPSHOT_VERSION;
+	header.flags = compress ? SNAPSHOT_COMPRESSED : 0;
+	header.snapshotSize = sizeof(Snapshot);
+
+	file.resize(sizeof(header));
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&snapshot);
+	if (compress) {
+		Compress(bytes, sizeof(Snapshot), file);
+	} else {
+		file.insert(file.end(), bytes, bytes + sizeof(Snapshot));
+	}
+
+	header.payloadSize = static_cast<uint32_t>(file.size() - sizeof(header));
+	memcpy(file.data(), &header, sizeof(header));
+}
+
+bool DecodeSnapshot(const uint8_t* file, size_t size, Snapshot& snapshot) {
+	SnapshotHeader header;
+	if (size < sizeof(header)) return false;
+	memcpy(&header, file, sizeof(header));
+
+	if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION) return false;
+	if (header.snapshotSize != sizeof(Snapshot) || header.payloadSize != size - sizeof(header)) return false;
+
+	const uint8_t* payload = file + sizeof(header);
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(&snapshot);
+	if (header.flags & SNAPSHOT_COMPRESSED) {
+		return Decompress(payload, header.payloadSize, bytes, sizeof(Snapshot));
+	}
+	if (header.payloadSize != sizeof(Snapshot)) return false;
+	memcpy(bytes, payload, sizeof(Snapshot));
+	return true;
+}
+
+bool WriteSnapshot(const std::string& fileName, const Snapshot& snapshot, bool compress) {
+	std::vector<uint8_t> file;
+	EncodeSnapshot(snapshot, compress, file);
+
+	std::ofstream out(fileName, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(file.data()), file.size());
+	return static_cast<bool>(out);
+}
+
+bool ReadSnapshot(const std::string& fileName, Snapshot& snapshot) {
+	std::ifstream in(fileName, std::ios::binary | std::ios::ate);
+	if (!in) return false;
+
+	std::vector<uint8_t> file(static_cast<size_t>(in.tellg()));
+	in.seekg(0, std::ios::beg);
+	in.read(reinterpret_cast<char*>(file.data()), file.size());
+	if (!in) return false;
+
+	return DecodeSnapshot(file.data(), file.size(), snapshot);
+}
+
+SnapshotWriter::SnapshotWriter() {
+	thread = std::thread([this] {
+		Work();
+	});
+}
+
+SnapshotWriter::~SnapshotWriter() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	queued.notify_one();
+	thread.join();
+}
+
+void SnapshotWriter::Save(const std::string& fileName, const Snapshot& snapshot, bool compress) {
+	std::unique_ptr<Job> job;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!spare.empty()) {
+			job = std::move(spare.back());
+			spare.pop_back();
+		}
+	}
+	if (!job) job.reset(new Job());
+
+	job->fileName = fileName;
+	job->snapshot = snapshot;
+	job->compress = compress;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queue.push_back(std::move(job));
+	}
+	queued.notify_one();
+}
+
+bool SnapshotWriter::Flush() {
+	std::unique_lock<std::mutex> lock(mutex);
+	drained.wait(lock, [this] { return queue.empty() && !writing; });
+
+	bool succeeded = !failed;
+	failed = false;
+	return succeeded;
+}
+
+void SnapshotWriter::Work() {
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		queued.wait(lock, [this] { return stopping || !queue.empty(); });
+		if (queue.empty()) return;
+
+		std::unique_ptr<Job> job = std::move(queue.front());
+		queue.pop_front();
+		writing = true;
+		lock.unlock();
+
+		bool written = WriteSnapshot(job->fileName, job->snapshot, job->compress);
+
+		lock.lock();
+		writing = false;
+		failed = failed || !written;
+		spare.push_back(std::move(job));
+		if (queue.empty()) drained.notify_all();
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "CPU.h"
+
+//"SI80" read as a little-endian word
+#define SNAPSHOT_MAGIC 0x30384953
+//bump whenever Snapshot changes layout, older files are then refused instead of misread
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_COMPRESSED 0x0001
+
+//the file is this header and then the Snapshot bytes, run-length encoded when flags has SNAPSHOT_COMPRESSED
+//fields are written in host order, which is little-endian on every target
+struct SnapshotHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t flags;
+	uint32_t snapshotSize;
+	uint32_t payloadSize;
+};
+
+//RAM is mostly runs of zeroes, so a byte-oriented RLE gets most of what a general compressor would at a fraction of the time
+void EncodeSnapshot(const Snapshot& snapshot, bool compress, std::vector<uint8_t>& file);
+bool DecodeSnapshot(const uint8_t* file, size_t size, Snapshot& snapshot);
+bool WriteSnapshot(const std::string& fileName, const Snapshot& snapshot, bool compress);
+bool ReadSnapshot(const std::string& fileName, Snapshot& snapshot);
+
+//writes snapshots from a thread of its own, so the emulation thread only pays for a copy
+class SnapshotWriter {
+public:
+	SnapshotWriter();
+	//writes whatever is still queued first
+	~SnapshotWriter();
+
+	void Save(const std::string& fileName, const Snapshot& snapshot, bool compress);
+	//blocks until every queued snapshot is written, false if any write failed since the last call
+	bool Flush();
+
+private:
+	struct Job {
+		std::string fileName;
+		Snapshot snapshot;
+		bool compress;
+	};
+
+	std::deque<std::unique_ptr<Job>> queue;
+	//finished jobs are kept for reuse, so saving does not allocate once a few have gone through
+	std::vector<std::unique_ptr<Job>> spare;
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable queued;
+	std::condition_variable drained;
+	bool writing = false;
+	bool stopping = false;
+	bool failed = false;
+
+	void Work();
+};
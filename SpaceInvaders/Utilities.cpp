@@ -1,11 +1,27 @@
 #include "Utilities.h"
+#include <iostream>
+#include <fstream>
 
 std::vector<char> LoadFile(const std::string& fileName) {
 	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (!file) {
+		std::cout << "Could not open \"" << fileName << "\"\n";
+		return {};
+	}
+
 	size_t size = file.tellg();
 	std::vector<char> buffer(size);
 	file.seekg(0, std::ios::beg);
 	file.read(buffer.data(), size);
 
 	return buffer;
-}
\ No newline at end of file
+}
+
+uint64_t HashBytes(const void* data, size_t size) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+	}
+	return hash;
+}
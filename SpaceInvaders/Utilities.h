@@ -1,12 +1,10 @@
-#include <vulkan/vulkan.h>
-#include <stdexcept>
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
 #include <vector>
-#include <fstream>
 
-#define VK_CHECK(exp, msg)                         \
-{                                                  \
-	VkResult result = exp;                         \
-	if (result < 0) throw std::runtime_error(msg); \
-}
-
-std::vector<char> LoadFile(const std::string& fileName);
\ No newline at end of file
+//the whole file, or nothing after reporting that it couldn't be opened
+std::vector<char> LoadFile(const std::string& fileName);
+//FNV-1a
+uint64_t HashBytes(const void* data, size_t size);
@@ -0,0 +1,11 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <stdexcept>
+
+#include "Utilities.h"
+
+#define VK_CHECK(exp, msg)                         \
+{                                                  \
+	VkResult result = exp;                         \
+	if (result < 0) throw std::runtime_error(msg); \
+}
@@ -1,8 +1,34 @@
 #include <iostream>
+#include <string>
+#include <algorithm>
 #include "Machine.h"
 
-int main() {
-	Machine machine;
+int main(int argc, char* args[]) {
+	MachineOptions options;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = args[i];
+		if (arg == "--run-ahead" && i + 1 < argc) {
+			options.runAheadFrames = std::min<size_t>(std::stoul(args[++i]), MAX_RUN_AHEAD_FRAMES);
+		} else if (arg == "--fast-forward" && i + 1 < argc) {
+			options.fastForward = std::max<size_t>(std::stoul(args[++i]), 1);
+		} else if (arg == "--speed" && i + 1 < argc) {
+			options.speed = std::stod(args[++i]);
+		} else {
+			std::cout << "usage: SpaceInvaders [--run-ahead frames] [--fast-forward frames] [--speed multiplier]\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	Machine machine(options);
 	machine.Run();
+
+	//run-ahead paces on the render thread, so the pacer only ran without it
+	const FramePacer& pacer = machine.GetPacer();
+	if (pacer.GetFrames() > 0) {
+		std::cout << "pacer: " << pacer.GetFrames() << " frames at " << pacer.GetSpeed() << "x"
+			<< ", jitter mean " << pacer.GetMeanJitter() << " us max " << pacer.GetMaxJitter() << " us"
+			<< ", " << pacer.GetResyncs() << " resyncs\n";
+	}
 	return 0;
-}
\ No newline at end of file
+}